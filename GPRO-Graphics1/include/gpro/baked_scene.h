@@ -0,0 +1,230 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	baked_scene.h
+	A header which stores a scene of spheres that is built at compile time. Declare it constexpr and the spheres and their
+	bounding volume hierarchy (BVH) are baked into the program, so there are no heap allocations or setup when the program starts.
+	Scenes with up to Baked_unroll_limit spheres skip the BVH and test every sphere in a loop the compiler unrolls
+
+	Example:
+		constexpr Baked_sphere spheres[2] = { Baked_sphere(point3(0, 0, -1), 0.5f), Baked_sphere(point3(0, -100.5f, -1), 100.0f) };
+		constexpr Baked_scene<2> scene(spheres);
+*/
+#pragma once
+#ifndef BAKED_SCENE_H
+#define BAKED_SCENE_H
+
+#include "hittable.h"
+#include "sphere.h"
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+const int Baked_unroll_limit = 8;	// Scenes this small are tested sphere by sphere instead of through the BVH
+const int Baked_leaf_size = 2;		// Most spheres in one BVH leaf
+
+// A sphere that can be made at compile time
+struct Baked_sphere {
+	constexpr Baked_sphere() : center(), radius(0.0f) {}; // Default ctor
+	constexpr Baked_sphere(point3 cen, float r) : center(cen), radius(r) {}; // Ctor with values
+
+	point3 center;	// Center of the sphere
+	float radius;	// Radius of the sphere
+};
+
+// A node of the BVH. Leaves hold spheres [first, first + count), the other nodes have two children
+struct Baked_node {
+	constexpr Baked_node() : box_min(), box_max(), left(-1), right(-1), first(0), count(0) {}; // Default ctor
+
+	point3 box_min;	// Corner of the bounding box with the smallest coordinates
+	point3 box_max;	// Corner of the bounding box with the largest coordinates
+	int left;		// Index of the first child, -1 for leaves
+	int right;		// Index of the second child, -1 for leaves
+	int first;		// First sphere of a leaf
+	int count;		// Number of spheres in a leaf
+};
+
+// Gets component axis (0 = x, 1 = y, 2 = z) of a vector. Reads the named members because the array member can not be read at compile time
+inline constexpr float baked_axis(const vec3& v, int axis)
+{
+	return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+inline constexpr float baked_min(float a, float b) { return a < b ? a : b; }
+inline constexpr float baked_max(float a, float b) { return a > b ? a : b; }
+
+template <int N>
+class Baked_scene : public Hittable {
+	static_assert(N > 0, "A baked scene needs at least one sphere");
+
+	public:
+		// Ctor that copies the spheres and builds the BVH, all at compile time when the scene is constexpr
+		constexpr explicit Baked_scene(const Baked_sphere (&list)[N]) : spheres(), nodes(), node_count(0)
+		{
+			for (int k = 0; k < N; ++k)
+			{
+				spheres[k] = list[k];
+			}
+			build(0, N);
+		}
+
+		// Override the hit function from Hittable
+		virtual bool hit(const ray& r, float tmin, float tmax, hit_record& rec) const override
+		{
+			return hit_spheres(r, tmin, tmax, rec, std::integral_constant<bool, (N <= Baked_unroll_limit)>());
+		}
+
+		// Override the bounding_box function from Hittable, the root of the BVH already has it
+		virtual bool bounding_box(point3& box_min, point3& box_max) const override
+		{
+			box_min = nodes[0].box_min;
+			box_max = nodes[0].box_max;
+			return true;
+		}
+
+		Baked_sphere spheres[N];		// Spheres in BVH order
+		Baked_node nodes[2 * N - 1];	// BVH nodes, nodes[0] is the root
+		int node_count;					// Nodes in use
+
+	private:
+		// Make the node for spheres [first, first + count) and its children, returns its index
+		constexpr int build(int first, int count)
+		{
+			const int index = node_count++;
+			Baked_node node;
+
+			// Bounds of the spheres and of their centers
+			point3 center_min = spheres[first].center, center_max = spheres[first].center;
+			node.box_min = spheres[first].center - vec3(spheres[first].radius, spheres[first].radius, spheres[first].radius);
+			node.box_max = spheres[first].center + vec3(spheres[first].radius, spheres[first].radius, spheres[first].radius);
+			for (int k = first + 1; k < first + count; ++k)
+			{
+				const point3& c = spheres[k].center;
+				const float rad = spheres[k].radius;
+				node.box_min = vec3(baked_min(node.box_min.x, c.x - rad), baked_min(node.box_min.y, c.y - rad), baked_min(node.box_min.z, c.z - rad));
+				node.box_max = vec3(baked_max(node.box_max.x, c.x + rad), baked_max(node.box_max.y, c.y + rad), baked_max(node.box_max.z, c.z + rad));
+				center_min = vec3(baked_min(center_min.x, c.x), baked_min(center_min.y, c.y), baked_min(center_min.z, c.z));
+				center_max = vec3(baked_max(center_max.x, c.x), baked_max(center_max.y, c.y), baked_max(center_max.z, c.z));
+			}
+
+			if (count <= Baked_leaf_size)
+			{
+				node.first = first;
+				node.count = count;
+				nodes[index] = node;
+				return index;
+			}
+
+			// Split at the median along the axis the centers are spread out the most on
+			const vec3 extent = center_max - center_min;
+			const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+			for (int k = first + 1; k < first + count; ++k)
+			{
+				// Insertion sort, scenes are small and this only runs while compiling
+				const Baked_sphere moving = spheres[k];
+				int slot = k;
+				while (slot > first && baked_axis(spheres[slot - 1].center, axis) > baked_axis(moving.center, axis))
+				{
+					spheres[slot] = spheres[slot - 1];
+					--slot;
+				}
+				spheres[slot] = moving;
+			}
+
+			const int half = count / 2;
+			node.left = build(first, half);
+			node.right = build(first + half, count - half);
+			nodes[index] = node;
+			return index;
+		}
+
+		// Small scenes: test every sphere, the pack expansion unrolls the loop
+		template <size_t... I>
+		bool hit_each(const ray& r, float tmin, float tmax, hit_record& rec, std::index_sequence<I...>) const
+		{
+			bool hit_anything = false;
+			float closest_so_far = tmax;
+			const bool hits[] = { (hit_sphere(spheres[I].center, spheres[I].radius, r, tmin, closest_so_far, rec) && (hit_anything = true) && ((closest_so_far = rec.t), true))... };
+			(void)hits;
+			return hit_anything;
+		}
+
+		bool hit_spheres(const ray& r, float tmin, float tmax, hit_record& rec, std::true_type) const
+		{
+			return hit_each(r, tmin, tmax, rec, std::make_index_sequence<size_t(N)>());
+		}
+
+		// Bigger scenes: walk the BVH and skip every node whose box the ray misses
+		bool hit_spheres(const ray& r, float tmin, float tmax, hit_record& rec, std::false_type) const
+		{
+			const vec3 direction = r.direction();
+			const vec3 origin = r.origin();
+			const vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+			int stack[64];	// Median splits keep the depth near log2(N)
+			int top = 0;
+			stack[top++] = 0;
+			bool hit_anything = false;
+			float closest_so_far = tmax;
+
+			while (top > 0)
+			{
+				const Baked_node& node = nodes[stack[--top]];
+
+				// Slab test against the node's box
+				float t0 = tmin, t1 = closest_so_far;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					float near_t = (node.box_min.v[axis] - origin.v[axis]) * inverse.v[axis];
+					float far_t = (node.box_max.v[axis] - origin.v[axis]) * inverse.v[axis];
+					if (near_t > far_t)
+					{
+						const float swap = near_t;
+						near_t = far_t;
+						far_t = swap;
+					}
+					t0 = near_t > t0 ? near_t : t0;
+					t1 = far_t < t1 ? far_t : t1;
+				}
+				if (t1 < t0)
+				{
+					continue;
+				}
+
+				if (node.left < 0)
+				{
+					for (int k = node.first; k < node.first + node.count; ++k)
+					{
+						if (hit_sphere(spheres[k].center, spheres[k].radius, r, tmin, closest_so_far, rec))
+						{
+							hit_anything = true;
+							closest_so_far = rec.t;
+						}
+					}
+				}
+				else
+				{
+					stack[top++] = node.right;
+					stack[top++] = node.left;
+				}
+			}
+			return hit_anything;
+		}
+};
+
+#endif
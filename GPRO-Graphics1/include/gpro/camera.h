@@ -0,0 +1,65 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	camera.h
+	A header which stores the camera class. Keeps the viewport vectors the test console builds by hand so other programs can create the same rays
+
+	This code is an edited version of Peter Shirley's Ray Tracing in One Weekend. Available at: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+#pragma once
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include "ray.h"
+
+class Camera {
+	public:
+		Camera() : Camera(16.0f / 9.0f, 2.0f, 1.0f) {}; // Default ctor (same viewport as the test console)
+		Camera(float aspect_ratio, float viewport_height, float focal_length) // Ctor with values
+		{
+			float viewport_width = aspect_ratio * viewport_height;
+
+			origin = point3(0, 0, 0);
+			horizontal = vec3(viewport_width, 0, 0);
+			vertical = vec3(0, viewport_height, 0);
+			lower_left_corner = origin - (horizontal / 2) - (vertical / 2) - vec3(0, 0, focal_length);
+		}
+		Camera(point3 lookfrom, point3 lookat, vec3 vup, float aspect_ratio, float viewport_height, float focal_length) // Ctor for a camera at lookfrom facing lookat, vup is roughly up
+		{
+			vec3 back = unit_vector(lookfrom - lookat);		// Points out of the back of the camera
+			vec3 right = unit_vector(cross(vup, back));		// Points to the right of the image
+			vec3 up = cross(back, right);					// Points to the top of the image
+
+			origin = lookfrom;
+			horizontal = right * (aspect_ratio * viewport_height);
+			vertical = up * viewport_height;
+			lower_left_corner = origin - (horizontal / 2) - (vertical / 2) - (back * focal_length);
+		}
+
+		// Get the ray going through the point (u, v) of the viewport, both vary from 0 to 1.
+		// lower_left_corner is a point in the world, so the direction is measured from the origin
+		ray get_ray(float u, float v) const {
+			return ray(origin, lower_left_corner + (horizontal * u) + (vertical * v) - origin);
+		}
+
+		point3 origin;				// Origin of the camera
+		point3 lower_left_corner;	// Lower left corner of the viewport (a point in the world, not relative to origin)
+		vec3 horizontal;			// Vector for tracking horizontal movement
+		vec3 vertical;				// Vector for tracking vertical movement
+};
+
+#endif
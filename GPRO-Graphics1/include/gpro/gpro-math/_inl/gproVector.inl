@@ -34,22 +34,22 @@
 #include <math.h>
 
 // Default ctor
-inline vec3::vec3()
+inline constexpr vec3::vec3()
 	: x(0.0f), y(0.0f), z(0.0f)
 {
 }
 // Ctor with variables 
-inline vec3::vec3(float const xc, float const yc, float const zc)
+inline constexpr vec3::vec3(float const xc, float const yc, float const zc)
 	: x(xc), y(yc), z(zc)
 {
 }
 // Copy ctor with a float3
-inline vec3::vec3(float3 const vc)
+inline constexpr vec3::vec3(float3 const vc)
 	: x(vc[0]), y(vc[1]), z(vc[2])
 {
 }
 // Copy ctor with a vector
-inline vec3::vec3(vec3 const& rh)
+inline constexpr vec3::vec3(vec3 const& rh)
 	: x(rh.x), y(rh.y), z(rh.z)
 {
 }
@@ -61,13 +61,13 @@ inline float vec3::length() const
 }
 
 // Calculates the length of the vector squared
-inline float vec3::length_squared() const
+inline constexpr float vec3::length_squared() const
 {
 	return ((x * x) + (y * y) + (z * z));
 }
 
 // Equals operator setting one vector equal to another
-inline vec3& vec3::operator =(vec3 const& rh)
+inline constexpr vec3& vec3::operator =(vec3 const& rh)
 {
 	x = rh.x;
 	y = rh.y;
@@ -76,7 +76,7 @@ inline vec3& vec3::operator =(vec3 const& rh)
 }
 
 // Adding another vector to a vector (changing the original)
-inline vec3& vec3::operator +=(vec3 const& rh)
+inline constexpr vec3& vec3::operator +=(vec3 const& rh)
 {
 	x += rh.x;
 	y += rh.y;
@@ -85,7 +85,7 @@ inline vec3& vec3::operator +=(vec3 const& rh)
 }
 
 // Multiplying a vector with a float (changing the original)
-inline vec3& vec3::operator *=(float const rh)
+inline constexpr vec3& vec3::operator *=(float const rh)
 {
 	x *= rh;
 	y *= rh;
@@ -94,25 +94,25 @@ inline vec3& vec3::operator *=(float const rh)
 }
 
 // Multipling a vector with a float (not changing the original)
-inline vec3 const vec3::operator *(float const rh) const
+inline constexpr vec3 const vec3::operator *(float const rh) const
 {
 	return vec3((x * rh), (y * rh), (z * rh));
 }
 
 // Adding a vector to another (not changing the original)
-inline vec3 const vec3::operator +(vec3 const& rh) const
+inline constexpr vec3 const vec3::operator +(vec3 const& rh) const
 {
 	return vec3((x + rh.x), (y + rh.y), (z + rh.z));
 }
 
 // Diving a vector by a float (not changing the original)
-inline vec3 const vec3::operator /(float rh) const
+inline constexpr vec3 const vec3::operator /(float rh) const
 {
 	return vec3((x / rh), (y / rh), (z / rh));
 }
 
 // Subtracting one vector from another (not changing the original)
-inline vec3 const vec3::operator -(vec3 const& rh) const
+inline constexpr vec3 const vec3::operator -(vec3 const& rh) const
 {
 	return vec3((x - rh.x), (y - rh.y), (z - rh.z));
 }
@@ -160,11 +160,17 @@ inline vec3 unit_vector(const vec3& rh)
 }
 
 // Calculates the dot product
-inline float dot(const vec3& u, const vec3& v)
+inline constexpr float dot(const vec3& u, const vec3& v)
 {
 	return ((u.x * v.x) + (u.y * v.y) + (u.z * v.z));
 }
 
+// Calculates the cross product
+inline constexpr vec3 cross(const vec3& u, const vec3& v)
+{
+	return vec3((u.y * v.z) - (u.z * v.y), (u.z * v.x) - (u.x * v.z), (u.x * v.y) - (u.y * v.x));
+}
+
 
 #endif	// !_GPRO_VECTOR_INL_
 #endif	// _GPRO_VECTOR_H_
\ No newline at end of file
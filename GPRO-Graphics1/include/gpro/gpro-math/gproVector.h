@@ -67,29 +67,30 @@ union vec3
 #ifdef __cplusplus
 	// DB: in C++ we can have convenient member functions
 	//	-> e.g. constructors, operators
+	// CD: everything but length is constexpr, so vectors (and scenes made of them) can be built at compile time
 
-	explicit vec3();	// default ctor
-	explicit vec3(float const xc, float const yc = 0.0f, float const zc = 0.0f);	// init ctor w one or more floats
-	explicit vec3(float3 const vc);	// copy ctor w generic array of floats
-	vec3(vec3 const& rh);	// copy ctor
+	constexpr explicit vec3();	// default ctor
+	constexpr explicit vec3(float const xc, float const yc = 0.0f, float const zc = 0.0f);	// init ctor w one or more floats
+	constexpr explicit vec3(float3 const vc);	// copy ctor w generic array of floats
+	constexpr vec3(vec3 const& rh);	// copy ctor
 
 	float length() const;	// gets the length of the vector
 
-	float length_squared() const;	// gets the squared length of the vector
+	constexpr float length_squared() const;	// gets the squared length of the vector
 
-	vec3& operator =(vec3 const& rh);	// assignment operator (copy other to this)
+	constexpr vec3& operator =(vec3 const& rh);	// assignment operator (copy other to this)
 
-	vec3& operator +=(vec3 const& rh);	// addition assignment operator (add other to this)
+	constexpr vec3& operator +=(vec3 const& rh);	// addition assignment operator (add other to this)
 
-	vec3& operator *=(const float rh);	// multiplication operator (multiply this by other)
+	constexpr vec3& operator *=(const float rh);	// multiplication operator (multiply this by other)
 
-	vec3 const operator *(float rh) const;			// multiplication operator (multiply this by other and return a new vec3)
+	constexpr vec3 const operator *(float rh) const;			// multiplication operator (multiply this by other and return a new vec3)
 
-	vec3 const operator +(vec3 const& rh) const;	// addition operator (get sum of this and another)
+	constexpr vec3 const operator +(vec3 const& rh) const;	// addition operator (get sum of this and another)
 
-	vec3 const operator /(float rh) const;			// division operator (divide each element by a float rh)
+	constexpr vec3 const operator /(float rh) const;			// division operator (divide each element by a float rh)
 
-	vec3 const operator -(vec3 const& rh) const;	// subtraction operator (subtract a vector and return a new vector)
+	constexpr vec3 const operator -(vec3 const& rh) const;	// subtraction operator (subtract a vector and return a new vector)
 
 #endif	// __cplusplus
 };
@@ -116,7 +117,8 @@ floatv vec3sum(float3 v_sum, float3 const v_lh, float3 const v_rh);	// get sum o
 // DB: end C linkage for C++ symbols
 }
 
-float dot(const vec3& u, const vec3& v);	// Calculates the dot product of two vectors
+constexpr float dot(const vec3& u, const vec3& v);	// Calculates the dot product of two vectors
+constexpr vec3 cross(const vec3& u, const vec3& v);	// Calculates the cross product of two vectors
 
 vec3 unit_vector(vec3 const& rh);			// Calculates the unit vector
 
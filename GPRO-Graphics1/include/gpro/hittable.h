@@ -53,6 +53,9 @@ struct hit_record {
 class Hittable {
 	public:
 		virtual bool hit(const ray& r, float t_min, float t_max, hit_record& rec) const = 0;
+
+		// Gets the box the object fits inside. Objects without one return false and are never culled
+		virtual bool bounding_box(point3& /*box_min*/, point3& /*box_max*/) const { return false; }
 };
 
 #endif
\ No newline at end of file
@@ -26,6 +26,7 @@
 
 #include "hittable.h"
 
+#include <cmath>
 #include <memory>
 #include <vector>
 
@@ -41,6 +42,7 @@ class Hittable_list : public Hittable {
 		void add(shared_ptr<Hittable> object) { objects.push_back(object); } //Add an object to the object vector
 
 		virtual bool hit(const ray& r, float tmin, float tmax, hit_record& rec) const override;	// Override the hit function from Hittable
+		virtual bool bounding_box(point3& box_min, point3& box_max) const override;	// Override the bounding_box function from Hittable
 
 		std::vector<shared_ptr<Hittable>> objects;	// Vector for storing hittable objects
 };
@@ -65,4 +67,19 @@ bool Hittable_list::hit(const ray& r, float tmin, float tmax, hit_record& rec) c
 	return hit_anything;
 }
 
+// Gets the box around every object in the list, false if the list is empty or something in it has no box
+bool Hittable_list::bounding_box(point3& box_min, point3& box_max) const {
+	point3 object_min, object_max;
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		if (!objects[i]->bounding_box(object_min, object_max))
+		{
+			return false;
+		}
+		box_min = i == 0 ? object_min : point3(fminf(box_min.x, object_min.x), fminf(box_min.y, object_min.y), fminf(box_min.z, object_min.z));
+		box_max = i == 0 ? object_max : point3(fmaxf(box_max.x, object_max.x), fmaxf(box_max.y, object_max.y), fmaxf(box_max.z, object_max.z));
+	}
+	return !objects.empty();
+}
+
 #endif
\ No newline at end of file
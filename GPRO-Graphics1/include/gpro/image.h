@@ -0,0 +1,142 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	image.h
+	A header which stores an image class so a render can be kept in memory instead of going straight to std::cout.
+	Also has functions to read/write PPM files and to compare two images (checksum and PSNR)
+*/
+#pragma once
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "color.h"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+class Image {
+	public:
+		Image() : width(0), height(0) {}; // Default ctor
+		Image(int w, int h) : width(w), height(h), pixels(size_t(w) * size_t(h)) {}; // Ctor with a size, every pixel starts black
+
+		// Pixel (i, j) uses the same indices as the render loop: i goes left-to-right and j goes bottom-to-top
+		color& at(int i, int j) { return pixels[size_t(j) * size_t(width) + size_t(i)]; }
+		const color& at(int i, int j) const { return pixels[size_t(j) * size_t(width) + size_t(i)]; }
+
+		int width;					// Width of the image in pixels
+		int height;					// Height of the image in pixels
+		std::vector<color> pixels;	// Pixels stored row by row starting at the bottom row
+};
+
+// Translates one color component into the [0, 255] value write_color prints
+inline int color_to_byte(float component)
+{
+	return static_cast<int>(255.99 * component);
+}
+
+// Write the image as a plain PPM, top row first (same output as the test console)
+inline void write_ppm(std::ostream& out, const Image& image)
+{
+	out << "P3\n" << image.width << ' ' << image.height << "\n255\n";
+	for (int j = image.height - 1; j >= 0; --j)
+	{
+		for (int i = 0; i < image.width; ++i)
+		{
+			write_color(out, image.at(i, j));
+		}
+	}
+}
+
+// Turns a byte written by write_ppm back into a color component that color_to_byte maps to the same byte
+inline float ppm_component(int value)
+{
+	return (float(value) + (value < 0 ? -0.5f : 0.5f)) / 255.99f;
+}
+
+// Read a plain PPM written by write_ppm, returns false if the stream is not one
+inline bool read_ppm(std::istream& in, Image& image)
+{
+	std::string magic;
+	int w = 0, h = 0, max_value = 0;
+	if (!(in >> magic >> w >> h >> max_value) || magic != "P3" || w <= 0 || h <= 0 || max_value != 255)
+	{
+		return false;
+	}
+
+	image = Image(w, h);
+	for (int j = h - 1; j >= 0; --j)
+	{
+		for (int i = 0; i < w; ++i)
+		{
+			int r, g, b;
+			if (!(in >> r >> g >> b))
+			{
+				return false;
+			}
+			// Store the middle of the byte so color_to_byte gives back the same value (it truncates toward zero, so negative bytes go the other way)
+			image.at(i, j) = color(ppm_component(r), ppm_component(g), ppm_component(b));
+		}
+	}
+	return true;
+}
+
+// FNV-1a hash of the bytes the image would write out, two images with the same checksum give the same file
+inline uint64_t image_checksum(const Image& image)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t k = 0; k < image.pixels.size(); ++k)
+	{
+		const int bytes[3] = { color_to_byte(image.pixels[k].x), color_to_byte(image.pixels[k].y), color_to_byte(image.pixels[k].z) };
+		for (int c = 0; c < 3; ++c)
+		{
+			hash ^= uint64_t(bytes[c] & 0xff);
+			hash *= 1099511628211ull;
+		}
+	}
+	return hash;
+}
+
+// Peak signal-to-noise ratio in dB between two images of the same size, infinity when they are identical
+inline float image_psnr(const Image& a, const Image& b)
+{
+	if (a.width != b.width || a.height != b.height || a.pixels.empty())
+	{
+		return 0.0f;
+	}
+
+	double squared_error = 0.0;
+	for (size_t k = 0; k < a.pixels.size(); ++k)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			double diff = double(color_to_byte(a.pixels[k].v[c]) - color_to_byte(b.pixels[k].v[c]));
+			squared_error += diff * diff;
+		}
+	}
+	if (squared_error == 0.0)
+	{
+		return std::numeric_limits<float>::infinity();
+	}
+	double mse = squared_error / double(a.pixels.size() * 3);
+	return float(10.0 * std::log10((255.0 * 255.0) / mse));
+}
+
+#endif
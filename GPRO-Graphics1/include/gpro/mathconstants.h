@@ -25,6 +25,7 @@
 #define MATHCONSTANTS_H
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <limits>
 #include <memory>
@@ -37,17 +38,43 @@ using std::sqrt;
 
 // Constants
 
-const float infinity = std::numeric_limits<float>::infinity();
-const float pi = float(3.1415926535897932385);
+constexpr float infinity = std::numeric_limits<float>::infinity();
+constexpr float pi = float(3.1415926535897932385);
 
 // Utility functions
 
 // This function can turn a number in degrees into radians
-inline float degrees_to_radians(float degrees)
+inline constexpr float degrees_to_radians(float degrees)
 {
 	return degrees * pi / 180.0f;
 }
 
+// Small xorshift random number generator. Gives the same numbers on every compiler, unlike the std distributions
+class Random {
+	public:
+		explicit Random(uint32_t seed = 1u) : state(seed != 0u ? seed : 1u) {}; // Ctor with a seed (0 is not allowed by xorshift)
+
+		// Get the next 32 random bits
+		uint32_t next_uint() {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		// Get a random float in [0, 1)
+		float next_float() {
+			return float(next_uint() >> 8) / 16777216.0f;
+		}
+
+		// Get a random float in [min, max)
+		float next_float(float min, float max) {
+			return min + (max - min) * next_float();
+		}
+
+		uint32_t state;	// Current state of the generator
+};
+
 // Common headers
 
 #include "ray.h"
@@ -0,0 +1,618 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	preview.h
+	A header which stores a live preview server. It listens on a localhost TCP port and streams every finished tile
+	(run-length encoded) to the connected clients, so the first pixels can be seen one tile into the render instead of one frame.
+
+	Render threads only encode the tile and push it onto a lock-free queue, they never wait on the network or on a lock.
+	A server thread does all the socket work. When more than max_queued messages are waiting, a tile is not queued but remembered,
+	and end_frame sends it again from the finished image, so clients that keep up always get every pixel of the frame.
+	A client that falls too far behind has the rest of that frame dropped, and the 'E' message tells it how many tiles it missed.
+
+	Messages (all numbers are little-endian uint32):
+		'F' frame width height				a new frame starts, every pixel is black
+		'T' frame x0 y0 x1 y1 size data	pixels [x0, x1) x [y0, y1) in Image order (bottom row first), data is size bytes of RLE runs
+		'E' frame dropped					the frame is done, dropped is how many of its tiles this client did not get
+	An RLE run is 4 bytes: run length (1 to 255), then red, green and blue
+*/
+#pragma once
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET preview_socket;
+const preview_socket preview_invalid_socket = INVALID_SOCKET;
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int preview_socket;
+const preview_socket preview_invalid_socket = -1;
+#endif
+
+// Socket helpers, so the rest of the file does not need to know which platform it is on
+
+inline bool preview_socket_startup()
+{
+#ifdef _WIN32
+	WSADATA data;
+	return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+	return true;
+#endif
+}
+
+inline void preview_socket_cleanup()
+{
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+inline void preview_close_socket(preview_socket s)
+{
+#ifdef _WIN32
+	closesocket(s);
+#else
+	close(s);
+#endif
+}
+
+inline void preview_set_nonblocking(preview_socket s)
+{
+#ifdef _WIN32
+	u_long on = 1;
+	ioctlsocket(s, FIONBIO, &on);
+#else
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+// Whether the last failed call only failed because the socket would have blocked
+inline bool preview_would_block()
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EWOULDBLOCK || errno == EAGAIN;
+#endif
+}
+
+// Send without raising SIGPIPE when the client has gone away, returns bytes sent or -1
+inline int preview_send(preview_socket s, const unsigned char* data, size_t size)
+{
+	const int chunk = int(std::min(size, size_t(1) << 20));
+#if defined(MSG_NOSIGNAL)
+	return int(send(s, reinterpret_cast<const char*>(data), size_t(chunk), MSG_NOSIGNAL));
+#elif defined(_WIN32)
+	return send(s, reinterpret_cast<const char*>(data), chunk, 0);
+#else
+	return int(send(s, reinterpret_cast<const char*>(data), size_t(chunk), 0));
+#endif
+}
+
+// Blocking read of exactly size bytes, false if the connection closed first
+inline bool preview_recv_all(preview_socket s, unsigned char* data, size_t size)
+{
+	while (size > 0)
+	{
+		const int chunk = int(std::min(size, size_t(1) << 20));
+		const int received = int(recv(s, reinterpret_cast<char*>(data), chunk, 0));
+		if (received <= 0)
+		{
+			return false;
+		}
+		data += received;
+		size -= size_t(received);
+	}
+	return true;
+}
+
+// Message encoding
+
+inline void preview_put_u32(std::vector<unsigned char>& out, uint32_t value)
+{
+	out.push_back(static_cast<unsigned char>(value & 0xff));
+	out.push_back(static_cast<unsigned char>((value >> 8) & 0xff));
+	out.push_back(static_cast<unsigned char>((value >> 16) & 0xff));
+	out.push_back(static_cast<unsigned char>((value >> 24) & 0xff));
+}
+
+inline uint32_t preview_get_u32(const unsigned char* in)
+{
+	return uint32_t(in[0]) | (uint32_t(in[1]) << 8) | (uint32_t(in[2]) << 16) | (uint32_t(in[3]) << 24);
+}
+
+// Same as color_to_byte, but clamped so it always fits in a byte
+inline unsigned char preview_byte(float component)
+{
+	return static_cast<unsigned char>(std::min(std::max(color_to_byte(component), 0), 255));
+}
+
+// Build the 'T' message for pixels [x0, x1) x [y0, y1) of the image
+inline void preview_encode_tile(const Image& image, uint32_t frame, int x0, int y0, int x1, int y1, std::vector<unsigned char>& out)
+{
+	out.clear();
+	out.push_back('T');
+	preview_put_u32(out, frame);
+	preview_put_u32(out, uint32_t(x0));
+	preview_put_u32(out, uint32_t(y0));
+	preview_put_u32(out, uint32_t(x1));
+	preview_put_u32(out, uint32_t(y1));
+	const size_t size_offset = out.size();
+	preview_put_u32(out, 0);	// Filled in once the size is known
+
+	unsigned char run[4] = { 0, 0, 0, 0 };
+	for (int j = y0; j < y1; ++j)
+	{
+		for (int i = x0; i < x1; ++i)
+		{
+			const color& c = image.at(i, j);
+			const unsigned char r = preview_byte(c.x), g = preview_byte(c.y), b = preview_byte(c.z);
+			if (run[0] > 0 && run[0] < 255 && run[1] == r && run[2] == g && run[3] == b)
+			{
+				++run[0];
+				continue;
+			}
+			if (run[0] > 0)
+			{
+				out.insert(out.end(), run, run + 4);
+			}
+			run[0] = 1;
+			run[1] = r;
+			run[2] = g;
+			run[3] = b;
+		}
+	}
+	if (run[0] > 0)
+	{
+		out.insert(out.end(), run, run + 4);
+	}
+
+	const uint32_t data_size = uint32_t(out.size() - size_offset - 4);
+	for (int k = 0; k < 4; ++k)
+	{
+		out[size_offset + size_t(k)] = static_cast<unsigned char>((data_size >> (8 * k)) & 0xff);
+	}
+}
+
+// Write the RLE runs of a 'T' message into pixels [x0, x1) x [y0, y1) of the image, false if they do not fit
+inline bool preview_decode_tile(const unsigned char* data, size_t size, int x0, int y0, int x1, int y1, Image& image)
+{
+	if (x0 < 0 || y0 < 0 || x1 > image.width || y1 > image.height || x0 > x1 || y0 > y1 || size % 4 != 0)
+	{
+		return false;
+	}
+
+	int i = x0, j = y0;
+	for (size_t k = 0; k < size; k += 4)
+	{
+		const color c((data[k + 1] + 0.5f) / 255.99f, (data[k + 2] + 0.5f) / 255.99f, (data[k + 3] + 0.5f) / 255.99f);
+		for (int n = 0; n < data[k]; ++n)
+		{
+			if (j >= y1)
+			{
+				return false;
+			}
+			image.at(i, j) = c;
+			if (++i == x1)
+			{
+				i = x0;
+				++j;
+			}
+		}
+	}
+	return true;
+}
+
+class Preview_server {
+	public:
+		Preview_server() : listener(preview_invalid_socket), running(false), stopping(false), client_count(0), frame(0),
+			inbox(nullptr), queued(0), missed(nullptr), resent(0) {}; // Default ctor
+		~Preview_server() { stop(); drain(); }
+
+		bool start(unsigned short port);			// Listen on 127.0.0.1:port and start the server thread, false if the port can not be used
+		void stop();								// Send what is still queued (for up to a second) and close everything
+		bool wait_for_client(int timeout_ms);		// Wait until a client is connected, false if none came in time
+
+		void begin_frame(int width, int height);	// Tell the clients a new frame starts
+		void push_tile(const Image& image, int x0, int y0, int x1, int y1);	// Queue a finished tile. Safe to call from render threads and never blocks
+		void end_frame(const Image& image);			// Send the tiles that did not fit in the queue again from the finished image, then tell the clients the frame is done
+
+		size_t resent_tiles() const { return resent; }	// Tiles that did not fit in the queue and were sent by end_frame instead
+
+		size_t max_queued = 4096;					// Most tiles waiting for the server thread
+		size_t max_client_backlog = 8u << 20;		// Most bytes waiting to be sent to one client before its frame is dropped
+
+	private:
+		struct Client {
+			preview_socket socket;
+			std::vector<unsigned char> pending;	// Bytes not sent yet
+			size_t sent;						// Bytes of pending already sent
+			bool has_frame;						// Whether the client got the 'F' of the current frame
+			bool skipping;						// Whether the rest of this frame is dropped for this client
+			uint32_t skipped;					// Tiles of this frame the client did not get
+		};
+
+		// A message on its way to the server thread
+		struct Message {
+			std::vector<unsigned char> bytes;
+			Message* next;
+		};
+
+		// A tile that did not fit in the queue
+		struct Missed_tile {
+			uint32_t frame;
+			int x0, y0, x1, y1;
+			Missed_tile* next;
+		};
+
+		void post(std::vector<unsigned char>& message);	// Hand a message to the server thread
+		void drain();						// Free whatever is still queued
+		void serve();						// Server thread loop
+		void route(const std::vector<unsigned char>& message);	// Add a message to every client's backlog
+		bool flush_client(Client& client);	// Send what the socket takes, false if the client is gone
+
+		preview_socket listener;
+		std::thread server_thread;
+		std::atomic<bool> running;
+		std::atomic<bool> stopping;
+		std::atomic<int> client_count;
+		std::atomic<uint32_t> frame;	// Id of the current frame
+
+		std::atomic<Message*> inbox;			// Messages waiting for the server thread, newest first
+		std::atomic<size_t> queued;				// Tiles in inbox
+		std::atomic<Missed_tile*> missed;		// Tiles end_frame has to send again
+		std::atomic<size_t> resent;
+		std::vector<Client> clients;			// Only used by the server thread
+};
+
+inline bool Preview_server::start(unsigned short port)
+{
+	if (running || !preview_socket_startup())
+	{
+		return false;
+	}
+
+	listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listener == preview_invalid_socket)
+	{
+		preview_socket_cleanup();
+		return false;
+	}
+
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);	// Only local clients
+	if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 8) != 0)
+	{
+		preview_close_socket(listener);
+		listener = preview_invalid_socket;
+		preview_socket_cleanup();
+		return false;
+	}
+	preview_set_nonblocking(listener);
+
+	running = true;
+	stopping = false;
+	server_thread = std::thread(&Preview_server::serve, this);
+	return true;
+}
+
+inline void Preview_server::stop()
+{
+	if (!running)
+	{
+		return;
+	}
+	stopping = true;
+	server_thread.join();
+	running = false;
+
+	preview_close_socket(listener);
+	listener = preview_invalid_socket;
+	preview_socket_cleanup();
+}
+
+inline bool Preview_server::wait_for_client(int timeout_ms)
+{
+	const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	while (running && client_count == 0 && std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return client_count > 0;
+}
+
+inline void Preview_server::begin_frame(int width, int height)
+{
+	std::vector<unsigned char> message;
+	message.push_back('F');
+	preview_put_u32(message, ++frame);
+	preview_put_u32(message, uint32_t(width));
+	preview_put_u32(message, uint32_t(height));
+	post(message);
+}
+
+inline void Preview_server::push_tile(const Image& image, int x0, int y0, int x1, int y1)
+{
+	if (!running || client_count == 0)
+	{
+		return;
+	}
+
+	// Over the limit, remember the tile instead of its pixels so end_frame can send it
+	if (++queued > max_queued)
+	{
+		--queued;
+		Missed_tile* tile = new Missed_tile();
+		tile->frame = frame.load();
+		tile->x0 = x0;
+		tile->y0 = y0;
+		tile->x1 = x1;
+		tile->y1 = y1;
+		tile->next = missed.load();
+		while (!missed.compare_exchange_weak(tile->next, tile))
+		{
+		}
+		return;
+	}
+
+	std::vector<unsigned char> message;
+	preview_encode_tile(image, frame.load(), x0, y0, x1, y1, message);
+	post(message);
+}
+
+inline void Preview_server::end_frame(const Image& image)
+{
+	// The render is done, so the pixels of the missed tiles are final
+	for (Missed_tile* tile = missed.exchange(nullptr); tile;)
+	{
+		Missed_tile* next = tile->next;
+		if (tile->frame == frame.load())
+		{
+			std::vector<unsigned char> message;
+			preview_encode_tile(image, tile->frame, tile->x0, tile->y0, tile->x1, tile->y1, message);
+			++queued;
+			post(message);
+			++resent;
+		}
+		delete tile;
+		tile = next;
+	}
+
+	std::vector<unsigned char> message;
+	message.push_back('E');
+	preview_put_u32(message, frame);
+	preview_put_u32(message, 0);	// Filled in per client by route
+	post(message);
+}
+
+// Push onto the lock-free inbox, the server thread takes the whole list at once so there is no ABA problem
+inline void Preview_server::post(std::vector<unsigned char>& message)
+{
+	Message* node = new Message();
+	node->bytes.swap(message);
+	node->next = inbox.load();
+	while (!inbox.compare_exchange_weak(node->next, node))
+	{
+	}
+}
+
+inline void Preview_server::drain()
+{
+	for (Message* node = inbox.exchange(nullptr); node;)
+	{
+		Message* next = node->next;
+		delete node;
+		node = next;
+	}
+	for (Missed_tile* tile = missed.exchange(nullptr); tile;)
+	{
+		Missed_tile* next = tile->next;
+		delete tile;
+		tile = next;
+	}
+	queued = 0;
+}
+
+inline void Preview_server::route(const std::vector<unsigned char>& message)
+{
+	for (size_t c = 0; c < clients.size(); ++c)
+	{
+		Client& client = clients[c];
+		if (message[0] == 'F')
+		{
+			client.has_frame = true;
+			client.skipping = false;
+			client.skipped = 0;
+		}
+		else if (!client.has_frame)
+		{
+			continue;	// Joined in the middle of a frame, wait for the next one
+		}
+		else if (message[0] == 'T')
+		{
+			// A client this far behind gets nothing more of this frame
+			if (client.skipping || client.pending.size() - client.sent > max_client_backlog)
+			{
+				client.skipping = true;
+				++client.skipped;
+				continue;
+			}
+		}
+
+		client.pending.insert(client.pending.end(), message.begin(), message.end());
+		if (message[0] == 'E')
+		{
+			const size_t at = client.pending.size() - 4;
+			for (int k = 0; k < 4; ++k)
+			{
+				client.pending[at + size_t(k)] = static_cast<unsigned char>((client.skipped >> (8 * k)) & 0xff);
+			}
+		}
+	}
+}
+
+inline bool Preview_server::flush_client(Client& client)
+{
+	while (client.sent < client.pending.size())
+	{
+		const int sent = preview_send(client.socket, client.pending.data() + client.sent, client.pending.size() - client.sent);
+		if (sent < 0)
+		{
+			return preview_would_block();
+		}
+		client.sent += size_t(sent);
+	}
+	client.pending.clear();
+	client.sent = 0;
+	return true;
+}
+
+inline void Preview_server::serve()
+{
+	std::vector<Message*> messages;
+	std::chrono::steady_clock::time_point flush_deadline;
+	bool flushing = false;
+
+	for (;;)
+	{
+		// Take in new clients
+		for (;;)
+		{
+			preview_socket s = accept(listener, nullptr, nullptr);
+			if (s == preview_invalid_socket)
+			{
+				break;
+			}
+			preview_set_nonblocking(s);
+			int no_delay = 1;
+			setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+			Client client;
+			client.socket = s;
+			client.sent = 0;
+			client.has_frame = false;
+			client.skipping = false;
+			client.skipped = 0;
+			clients.push_back(client);
+		}
+		client_count = int(clients.size());
+
+		// Hand the queued messages to the clients
+		for (Message* node = inbox.exchange(nullptr); node; node = node->next)
+		{
+			messages.push_back(node);
+		}
+		for (size_t m = messages.size(); m-- > 0;)	// The inbox is newest first
+		{
+			if (messages[m]->bytes[0] == 'T')
+			{
+				--queued;
+			}
+			route(messages[m]->bytes);
+			delete messages[m];
+		}
+		messages.clear();
+
+		// Send what each socket takes and forget clients that went away
+		bool backlog = false;
+		for (size_t c = 0; c < clients.size();)
+		{
+			if (!flush_client(clients[c]))
+			{
+				preview_close_socket(clients[c].socket);
+				clients.erase(clients.begin() + std::ptrdiff_t(c));
+				continue;
+			}
+			backlog = backlog || !clients[c].pending.empty();
+			++c;
+		}
+		client_count = int(clients.size());
+
+		// When stopping, keep going until everything is sent or a second has passed
+		if (stopping)
+		{
+			if (!flushing)
+			{
+				flushing = true;
+				flush_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+				continue;
+			}
+			const bool queue_empty = inbox.load() == nullptr;
+			if ((queue_empty && !backlog) || std::chrono::steady_clock::now() >= flush_deadline)
+			{
+				break;
+			}
+		}
+
+		// Wait until a socket is ready or a short time has passed, whichever is first
+		fd_set read_set, write_set;
+		FD_ZERO(&read_set);
+		FD_ZERO(&write_set);
+		FD_SET(listener, &read_set);
+		preview_socket highest = listener;
+		for (size_t c = 0; c < clients.size(); ++c)
+		{
+			if (!clients[c].pending.empty())
+			{
+				FD_SET(clients[c].socket, &write_set);
+				highest = std::max(highest, clients[c].socket);
+			}
+		}
+		timeval timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 1000;
+		select(int(highest + 1), &read_set, &write_set, nullptr, &timeout);
+	}
+
+	for (size_t c = 0; c < clients.size(); ++c)
+	{
+		preview_close_socket(clients[c].socket);
+	}
+	clients.clear();
+	client_count = 0;
+}
+
+#endif
@@ -0,0 +1,202 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	progressive.h
+	A header which stores a progressive renderer that works inside a time budget.
+	The first pass traces one ray per coarse block (8x8 by default) and fills the whole block with it, so there is a full image right away.
+	Every pass after that halves the block size and only traces the pixels the passes before it have not, until the blocks are single pixels
+	or the deadline hits. Whatever is in the image when it returns is the best image so far, and a finished render gives the same pixels as render()
+*/
+#pragma once
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+#include "render.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// Options for render_progressive
+struct Progressive_settings {
+	double time_budget_ms = 0.0;	// Time to stop refining after, 0 or less renders every pass
+	int coarse_block = 8;			// Block size of the first pass, rounded down to a power of two
+	int thread_count = 0;			// Number of threads to render with, 0 uses every hardware thread
+	bool cull_tiles = true;			// Bin the objects of a Hittable_list world into screen tiles first, see tile_bins.h
+};
+
+// Timing of one pass
+struct Progressive_pass {
+	int block_size = 0;			// Size of the blocks this pass fills
+	double elapsed_ms = 0.0;	// Time since the render started when this pass stopped
+	bool complete = false;		// Whether the pass traced every pixel it had to before the deadline
+};
+
+// What render_progressive got done
+struct Progressive_result {
+	double elapsed_ms = 0.0;			// Time the render took
+	long long traced_pixels = 0;		// Pixels that got their own ray
+	int finest_block = 0;				// Block size of the last pass that finished (1 means the image is complete)
+	std::vector<Progressive_pass> passes;	// One entry per pass that was started, for quality-versus-time curves
+
+	bool complete() const { return finest_block == 1; }
+};
+
+// One piece of work inside a pass: up to Progressive_chunk_samples samples along one row of blocks
+struct Progressive_chunk {
+	int j;		// Row of the samples
+	int first;	// Column of the first sample
+	int stride;	// Columns between samples
+	int count;	// Number of samples
+};
+
+const int Progressive_chunk_samples = 64;	// The deadline is checked before each chunk, so this bounds how far a pass can run over
+
+// Reverses the low bits of a row index so a pass that gets cut off is spread over the whole image instead of only the bottom
+inline int progressive_row_order(int row, int bits)
+{
+	int reversed = 0;
+	for (int b = 0; b < bits; ++b)
+	{
+		reversed = (reversed << 1) | ((row >> b) & 1);
+	}
+	return reversed;
+}
+
+// Lists the samples of the pass with blocks of size step. The first pass traces every multiple of step,
+// later passes skip the samples that are also on the grid of the pass before (multiples of 2 * step)
+inline void progressive_pass_chunks(int width, int height, int step, bool first_pass, std::vector<Progressive_chunk>& chunks)
+{
+	chunks.clear();
+	const int rows = (height + step - 1) / step;
+	int bits = 0;
+	while ((1 << bits) < rows)
+	{
+		++bits;
+	}
+
+	std::vector<int> order;
+	for (int row = 0; row < (1 << bits); ++row)
+	{
+		int reversed = progressive_row_order(row, bits);
+		if (reversed < rows)
+		{
+			order.push_back(reversed);
+		}
+	}
+
+	for (size_t k = 0; k < order.size(); ++k)
+	{
+		const int j = order[k] * step;
+		const bool shared_row = !first_pass && (j % (2 * step)) == 0;	// Every other sample on this row was traced last pass
+		const int first = shared_row ? step : 0;
+		const int stride = shared_row ? 2 * step : step;
+		const int samples = first < width ? (width - first + stride - 1) / stride : 0;
+		for (int s = 0; s < samples; s += Progressive_chunk_samples)
+		{
+			Progressive_chunk chunk;
+			chunk.j = j;
+			chunk.first = first + s * stride;
+			chunk.stride = stride;
+			chunk.count = std::min(Progressive_chunk_samples, samples - s);
+			chunks.push_back(chunk);
+		}
+	}
+}
+
+// Render the image coarse-to-fine until it is complete or the time budget runs out.
+// The first pass always finishes so the image never has holes, even if that takes longer than the budget
+inline Progressive_result render_progressive(const Hittable& world, const Camera& cam, Image& image, const Progressive_settings& settings = Progressive_settings())
+{
+	typedef std::chrono::steady_clock clock;
+	const clock::time_point start = clock::now();
+	const bool has_deadline = settings.time_budget_ms > 0.0;
+	const clock::time_point deadline = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::milli>(settings.time_budget_ms));
+
+	int coarse = 1;
+	while (coarse * 2 <= settings.coarse_block)
+	{
+		coarse *= 2;
+	}
+
+	// Bin once up front, every pass traces the same primary rays as render() so the same bins hold
+	Render_settings bin_settings;
+	bin_settings.cull_tiles = settings.cull_tiles;
+	Tile_bins bins;
+	const Tile_bins* tile_bins = prepare_tiles(world, cam, image, bin_settings, bins);
+
+	Progressive_result result;
+	std::vector<Progressive_chunk> chunks;
+	std::atomic<long long> traced(0);
+
+	for (int step = coarse; step >= 1; step /= 2)
+	{
+		const bool first_pass = step == coarse;
+		if (!first_pass && has_deadline && clock::now() >= deadline)
+		{
+			break;
+		}
+
+		progressive_pass_chunks(image.width, image.height, step, first_pass, chunks);
+		std::atomic<bool> out_of_time(false);
+		run_parallel(int(chunks.size()), settings.thread_count, [&](int k)
+		{
+			if (!first_pass && has_deadline && (out_of_time || clock::now() >= deadline))
+			{
+				out_of_time = true;
+				return;
+			}
+
+			const Progressive_chunk& chunk = chunks[size_t(k)];
+			const int j1 = std::min(chunk.j + step, image.height);
+			for (int s = 0; s < chunk.count; ++s)
+			{
+				// Trace the sample and fill its block, blocks in one pass never overlap so threads do not need to lock
+				const int i = chunk.first + s * chunk.stride;
+				const int i1 = std::min(i + step, image.width);
+				const Hittable& sample_world = tile_bins ? static_cast<const Hittable&>(tile_bins->tile_at(i, chunk.j)) : world;
+				const color pixel_color = render_pixel(sample_world, cam, i, chunk.j, image.width, image.height);
+				for (int j = chunk.j; j < j1; ++j)
+				{
+					for (int x = i; x < i1; ++x)
+					{
+						image.at(x, j) = pixel_color;
+					}
+				}
+			}
+			traced += chunk.count;
+		});
+
+		Progressive_pass pass;
+		pass.block_size = step;
+		pass.elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+		pass.complete = !out_of_time;
+		result.passes.push_back(pass);
+		if (!pass.complete)
+		{
+			break;
+		}
+		result.finest_block = step;
+	}
+
+	result.elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	result.traced_pixels = traced;
+	return result;
+}
+
+#endif
@@ -28,14 +28,14 @@
 
 class ray {
 	public:
-		ray(){} // Default ctor
-		ray(const point3& origin, const vec3& direction) : orig(origin), dir(direction) {}; // Ctor with values
+		constexpr ray() : orig(), dir() {} // Default ctor
+		constexpr ray(const point3& origin, const vec3& direction) : orig(origin), dir(direction) {}; // Ctor with values
 
-		point3 origin() const { return orig; }	// Get the origin
-		vec3 direction() const { return dir; }	// Get the direction
+		constexpr point3 origin() const { return orig; }	// Get the origin
+		constexpr vec3 direction() const { return dir; }	// Get the direction
 
 		// Think of the function P(t) = A + tb
-		point3 at(float t) const {
+		constexpr point3 at(float t) const {
 			return orig + (dir * t);
 		}
 
@@ -0,0 +1,265 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	render.h
+	A header which stores the functions that turn a world and a camera into an image.
+	render_reference is the scanline loop from the test console and gives the pixels golden images hold,
+	render splits the image into tiles and shares them between the calling thread and the workers of the shared pool (see render_pool.h),
+	and when the world is a Hittable_list each tile only tests the objects whose bounds project onto it (see tile_bins.h).
+	render_job.h queues the same tiles on the pool without blocking
+
+	This code is an edited version of Peter Shirley's Ray Tracing in One Weekend. Available at: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+#pragma once
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "mathconstants.h"
+#include "hittable.h"
+#include "camera.h"
+#include "image.h"
+#include "tile_bins.h"
+#include "render_pool.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// Gets the color of the ray based on any collisions, rec and hit_anything tell the caller what the ray hit
+inline color ray_color(const ray& r, const Hittable& world, hit_record& rec, bool& hit_anything)
+{
+	hit_anything = world.hit(r, 0, infinity, rec);
+	if (hit_anything) // If there is a collision
+	{
+		// Get the normal and white to it then multiply by half
+		return (rec.normal + color(1, 1, 1)) * 0.5f;
+	}
+	//Create the gradient in the background
+	vec3 unit_direction = unit_vector(r.direction());
+	float t = (unit_direction.y + 1.0f) * 0.5f;
+	return (color(1.0f, 1.0f, 1.0f) * (1.0f - t) + (color(0.5f, 0.7f, 1.0f) * t));
+}
+
+// Gets the color of the ray based on any collisions
+inline color ray_color(const ray& r, const Hittable& world)
+{
+	//Creates a hit_record to store the hit
+	hit_record rec;
+	bool hit_anything;
+	return ray_color(r, world, rec, hit_anything);
+}
+
+// Gets the color of pixel (i, j), uses the same math as the test console so every render path gives the same pixels
+inline color render_pixel(const Hittable& world, const Camera& cam, int i, int j, int image_width, int image_height)
+{
+	float u = float(i) / (image_width - 1);		// 'u' will vary from 0 to 1
+	float v = float(j) / (image_height - 1);	// 'v' will vary from 0 to 1
+	return ray_color(cam.get_ray(u, v), world);
+}
+
+const float background_depth = 1.0e4f;	// Depth stored for pixels whose center ray hits nothing
+
+// What the primary rays of every pixel hit, averaged over its samples, and how noisy its color is. render fills these when asked for the denoiser
+struct Feature_buffers {
+	Image normal;					// Surface normal, (0, 0, 0) for the background
+	std::vector<float> depth;		// t of the hit, background_depth for the background
+	std::vector<float> variance;	// How far the pixel's color may be from the true one (variance of the average, summed over r, g and b), 0 with one sample
+
+	void resize(int width, int height)
+	{
+		normal = Image(width, height);
+		depth.assign(normal.pixels.size(), background_depth);
+		variance.assign(normal.pixels.size(), 0.0f);
+	}
+};
+
+// Gets the color of pixel (i, j) averaged over samples_per_pixel rays. The first ray goes through the center of the pixel
+// (so one sample gives the same pixel as render_pixel), the rest are jittered inside it.
+// The random numbers only depend on the pixel, so the image does not depend on the number of threads or on the tiles.
+// When features is not null it gets the normal and depth of the primary hits, averaged the same way as the color, and how noisy the color is
+inline color render_pixel_samples(const Hittable& world, const Camera& cam, int i, int j, int image_width, int image_height,
+	int samples_per_pixel, Feature_buffers* features)
+{
+	hit_record rec;
+	bool hit_anything;
+	color pixel_color(0.0f, 0.0f, 0.0f);
+	color color_squares(0.0f, 0.0f, 0.0f);
+	vec3 normal(0.0f, 0.0f, 0.0f);
+	float depth = 0.0f;
+	Random rng(uint32_t(j * image_width + i) * 2654435761u + 1u);
+
+	for (int s = 0; s < samples_per_pixel; ++s)
+	{
+		float u = float(i) / (image_width - 1);
+		float v = float(j) / (image_height - 1);
+		if (s > 0)
+		{
+			u = (float(i) + rng.next_float(-0.5f, 0.5f)) / (image_width - 1);
+			v = (float(j) + rng.next_float(-0.5f, 0.5f)) / (image_height - 1);
+		}
+		const color sample = ray_color(cam.get_ray(u, v), world, rec, hit_anything);
+		pixel_color += sample;
+		if (features)
+		{
+			color_squares += color(sample.x * sample.x, sample.y * sample.y, sample.z * sample.z);
+			normal += hit_anything ? rec.normal : vec3(0.0f, 0.0f, 0.0f);
+			depth += hit_anything ? rec.t : background_depth;
+		}
+	}
+
+	if (samples_per_pixel == 1)
+	{
+		// Keep the exact color of the single ray so it matches render_pixel bit for bit
+		if (features)
+		{
+			features->normal.at(i, j) = normal;
+			features->depth[size_t(j) * size_t(image_width) + size_t(i)] = depth;
+		}
+		return pixel_color;
+	}
+
+	const float scale = 1.0f / float(samples_per_pixel);
+	if (features)
+	{
+		features->normal.at(i, j) = normal * scale;
+		features->depth[size_t(j) * size_t(image_width) + size_t(i)] = depth * scale;
+
+		// Variance of the samples over the sample count is the variance of their average
+		const color mean = pixel_color * scale;
+		const color mean_squares = color_squares * scale;
+		const float spread = (mean_squares.x - mean.x * mean.x) + (mean_squares.y - mean.y * mean.y) + (mean_squares.z - mean.z * mean.z);
+		features->variance[size_t(j) * size_t(image_width) + size_t(i)] = std::max(spread, 0.0f) / float(samples_per_pixel - 1);
+	}
+	return pixel_color * scale;
+}
+
+// Options for render
+struct Render_settings {
+	int thread_count = 0;	// Number of threads to render with, 0 uses every hardware thread
+	int tile_size = 16;		// Width and height of a tile in pixels
+	int samples_per_pixel = 1;	// Rays averaged per pixel
+	Feature_buffers* features = nullptr;	// Filled with the primary hits when not null
+	bool cull_tiles = true;	// Bin the objects of a Hittable_list world into the tiles first, gives the same pixels with fewer tests
+
+	// Called by the render thread right after it finishes pixels [x0, x1) x [y0, y1), has to be quick and thread safe
+	std::function<void(int x0, int y0, int x1, int y1)> tile_done;
+};
+
+// Render one scanline at a time on the calling thread
+inline void render_reference(const Hittable& world, const Camera& cam, Image& image)
+{
+	for (int j = image.height - 1; j >= 0; --j)
+	{
+		for (int i = 0; i < image.width; ++i)
+		{
+			image.at(i, j) = render_pixel(world, cam, i, j, image.width, image.height);
+		}
+	}
+}
+
+// The tasks of one run_parallel call as a job on the shared pool
+template <typename Task>
+struct Parallel_tasks : Pool_job {
+	Parallel_tasks(int count, int thread_count, const Task& function)
+		: Pool_job(&Render_pool::shared(), count, thread_count, 0, false), task(function) {}
+
+	virtual void run_task(int k) override { task(k); }
+
+	const Task& task;	// What to run for every task
+};
+
+// Run task(0) to task(task_count - 1) on up to thread_count threads (the calling thread included) and return when they are all done.
+// The other threads are workers of Render_pool::shared(), so this waits its turn behind queued jobs with a higher priority
+// instead of starting threads of its own, and the calling thread keeps taking tasks so it never waits for a free worker
+template <typename Task>
+inline void run_parallel(int task_count, int thread_count, const Task& task)
+{
+	thread_count = std::min(resolve_thread_count(thread_count), std::max(task_count, 1));
+	if (thread_count == 1)
+	{
+		for (int k = 0; k < task_count; ++k)
+		{
+			task(k);
+		}
+		return;
+	}
+
+	Parallel_tasks<Task> job(task_count, thread_count, task);
+	Render_pool::shared().run_tasks(job);
+}
+
+// Get ready to render tiles: sizes the feature buffers and bins the objects into the tiles.
+// Returns the bins, or null when the world is tested as a whole (culling is off or the world is not a Hittable_list)
+inline const Tile_bins* prepare_tiles(const Hittable& world, const Camera& cam, const Image& image, const Render_settings& settings, Tile_bins& bins)
+{
+	if (settings.features)
+	{
+		settings.features->resize(image.width, image.height);
+	}
+
+	const Hittable_list* list = settings.cull_tiles ? dynamic_cast<const Hittable_list*>(&world) : nullptr;
+	if (!list)
+	{
+		return nullptr;
+	}
+	bins.build(*list, cam, image.width, image.height, std::max(settings.tile_size, 1));
+	return &bins;
+}
+
+// Number of tiles render splits the image into
+inline int render_tile_count(const Image& image, const Render_settings& settings)
+{
+	const int tile_size = std::max(settings.tile_size, 1);
+	return ((image.width + tile_size - 1) / tile_size) * ((image.height + tile_size - 1) / tile_size);
+}
+
+// Render tile number tile (tile_y * tiles_x + tile_x) of the image, then tell settings.tile_done about it
+inline void render_tile(const Hittable& world, const Tile_bins* bins, const Camera& cam, Image& image, const Render_settings& settings, int tile)
+{
+	const int tile_size = std::max(settings.tile_size, 1);
+	const int tiles_x = (image.width + tile_size - 1) / tile_size;
+	const int samples_per_pixel = std::max(settings.samples_per_pixel, 1);
+	const int x0 = (tile % tiles_x) * tile_size;
+	const int y0 = (tile / tiles_x) * tile_size;
+	const int x1 = std::min(x0 + tile_size, image.width);
+	const int y1 = std::min(y0 + tile_size, image.height);
+	const Hittable& tile_world = bins ? static_cast<const Hittable&>(bins->tile(tile)) : world;
+	for (int j = y0; j < y1; ++j)
+	{
+		for (int i = x0; i < x1; ++i)
+		{
+			image.at(i, j) = render_pixel_samples(tile_world, cam, i, j, image.width, image.height, samples_per_pixel, settings.features);
+		}
+	}
+	if (settings.tile_done)
+	{
+		settings.tile_done(x0, y0, x1, y1);
+	}
+}
+
+// Render the image in tiles shared between threads
+inline void render(const Hittable& world, const Camera& cam, Image& image, const Render_settings& settings = Render_settings())
+{
+	Tile_bins bins;
+	const Tile_bins* tile_bins = prepare_tiles(world, cam, image, settings, bins);
+	run_parallel(render_tile_count(image, settings), settings.thread_count, [&](int tile)
+	{
+		render_tile(world, tile_bins, cam, image, settings, tile);
+	});
+}
+
+#endif
@@ -0,0 +1,275 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	render_job.h
+	A header which stores the asynchronous render API. render(world, cam, job_settings) queues a job on a shared pool of worker threads
+	and returns a Render_job handle right away. The handle can wait for the image, cancel the job or change its priority.
+
+	Every job is split into the same tiles as render() and queued on the pool from render_pool.h. Workers take one tile at a time from
+	the job with the highest priority (the oldest one on a tie), so jobs running at the same time share the pool with each other and
+	with blocking renders instead of each starting its own threads, a new high priority job gets the next free worker,
+	and a cancelled job stops after the tiles that are already being rendered.
+	Progress callbacks run on the worker threads, never more often than progress_interval_ms and never two at once for one job.
+	The last callback (finished or cancelled) runs before wait() returns.
+	A thread that waits for a job renders the job's remaining tiles itself (and so may run its callbacks), which keeps waiting safe
+	from inside a callback or a task on the pool when every worker is busy
+*/
+#pragma once
+#ifndef RENDER_JOB_H
+#define RENDER_JOB_H
+
+#include "render.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Where a job is
+enum Render_status {
+	render_queued,		// Waiting for a worker
+	render_running,		// At least one tile was started
+	render_finished,	// Every tile is done
+	render_cancelled	// Stopped before every tile was done
+};
+
+// What a progress callback gets
+struct Render_progress {
+	Render_status status = render_queued;
+	int tiles_done = 0;			// Tiles finished so far
+	int tile_count = 0;			// Tiles in the image
+	double elapsed_ms = 0.0;	// Time since the job was submitted
+
+	float fraction() const { return tile_count > 0 ? float(tiles_done) / float(tile_count) : 0.0f; }
+};
+
+// Options for a render job, thread_count is the most workers the job may use at once (0 = any)
+struct Render_job_settings : Render_settings {
+	int width = 400;						// Width of the image in pixels
+	int height = 225;						// Height of the image in pixels
+	int priority = 0;						// Jobs with a higher priority get free workers first
+	double progress_interval_ms = 100.0;	// Least time between two progress callbacks
+
+	// Called on a worker thread as tiles get done and once more when the job is finished or cancelled
+	std::function<void(const Render_progress& progress)> progress;
+};
+
+// Everything about one render job, shared by its handle and the pool. The fields under "pool" are guarded by the pool's mutex
+struct Render_job_state : Pool_job {
+	typedef std::chrono::steady_clock clock;
+
+	Render_job_state(Render_pool* owner, const Hittable& scene, const Camera& camera, const Render_job_settings& job_settings)
+		: Pool_job(owner, 0, job_settings.thread_count, job_settings.priority, true), world(&scene), cam(camera), settings(job_settings),
+		image(job_settings.width, job_settings.height), bins_used(nullptr), reporting(false), submitted(clock::now()), last_progress(submitted),
+		status(render_queued)
+	{
+		task_count = render_tile_count(image, job_settings);
+	}
+
+	Render_progress snapshot() const
+	{
+		Render_progress progress;
+		progress.status = Render_status(status.load());
+		progress.tiles_done = tasks_done;
+		progress.tile_count = task_count;
+		progress.elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - submitted).count();
+		return progress;
+	}
+
+	virtual void prepare() override;
+	virtual void run_task(int tile) override;
+	virtual void task_finished(std::unique_lock<std::mutex>& lock) override;
+	virtual void finish() override;
+
+	const Hittable* world;			// Scene, has to outlive the job
+	Camera cam;						// Copy of the camera
+	Render_job_settings settings;	// Copy of the settings
+	Image image;					// Where the tiles go
+	Tile_bins bins;					// Objects of each tile, built by prepare
+	const Tile_bins* bins_used;		// &bins, or null when the world is not culled
+
+	// Pool
+	bool reporting;					// A worker is running a progress callback
+	clock::time_point submitted;	// When the job was submitted
+	clock::time_point last_progress;	// When the last progress callback started
+
+	std::atomic<int> status;				// A Render_status
+	std::mutex done_mutex;					// Guards waiting for the job
+	std::condition_variable done;			// Signalled when status becomes finished or cancelled
+};
+
+// Handle to a queued job. Dropping the last handle cancels the job and waits for it, so the world it renders can be destroyed afterwards
+class Render_job {
+	public:
+		Render_job() {};	// Default ctor, an empty handle
+		explicit Render_job(std::shared_ptr<Render_job_state> job) : state(job) {};	// Ctor used by Render_pool
+		Render_job(Render_job&& other) : state(std::move(other.state)) {};	// Move ctor
+		Render_job& operator =(Render_job&& other);	// Move assignment, cancels the job this handle had
+		Render_job(const Render_job&) = delete;	// One handle per job
+		Render_job& operator =(const Render_job&) = delete;
+		~Render_job() { reset(); }
+
+		bool valid() const { return state != nullptr; }	// Whether the handle has a job
+		void cancel();									// Ask the job to stop, tiles that were started still finish
+		void set_priority(int priority);				// Change the job's priority, takes effect for the next free worker
+		void wait() const;								// Wait until the job is finished or cancelled
+		bool wait_for(double timeout_ms) const;			// Wait up to timeout_ms, true if the job is over
+		Render_status status() const { return state ? Render_status(state->status.load()) : render_cancelled; }	// Where the job is
+		Render_progress progress() const { return state ? state->snapshot() : Render_progress(); }			// Tiles done so far
+		const Image& image() const;						// The finished (or, if cancelled, partial) image, waits for the job. Empty for an empty handle
+		void reset();									// Cancel the job, wait for it and empty the handle
+
+	private:
+		std::shared_ptr<Render_job_state> state;
+};
+
+inline Render_job& Render_job::operator =(Render_job&& other)
+{
+	if (this != &other)
+	{
+		reset();
+		state = std::move(other.state);
+	}
+	return *this;
+}
+
+inline void Render_job::cancel()
+{
+	if (state)
+	{
+		state->cancel_requested = true;
+		state->pool->notify();	// A job nobody is working on gets finished by the next free worker
+	}
+}
+
+inline void Render_job::set_priority(int priority)
+{
+	if (state)
+	{
+		state->pool->set_priority(*state, priority);
+	}
+}
+
+inline void Render_job::wait() const
+{
+	if (state)
+	{
+		state->pool->work_on(state);
+		std::unique_lock<std::mutex> lock(state->done_mutex);
+		state->done.wait(lock, [&]() { return state->status >= render_finished; });
+	}
+}
+
+inline bool Render_job::wait_for(double timeout_ms) const
+{
+	if (!state)
+	{
+		return true;
+	}
+	const Render_job_state::clock::time_point deadline = Render_job_state::clock::now() +
+		std::chrono::duration_cast<Render_job_state::clock::duration>(std::chrono::duration<double, std::milli>(timeout_ms));
+	if (!state->pool->work_on(state, &deadline))
+	{
+		return false;
+	}
+	std::unique_lock<std::mutex> lock(state->done_mutex);
+	return state->done.wait_until(lock, deadline, [&]() { return state->status >= render_finished; });
+}
+
+inline const Image& Render_job::image() const
+{
+	static const Image no_image;
+	if (!state)
+	{
+		return no_image;
+	}
+	wait();
+	return state->image;
+}
+
+inline void Render_job::reset()
+{
+	if (state)
+	{
+		cancel();
+		wait();
+		state.reset();
+	}
+}
+
+inline void Render_job_state::prepare()
+{
+	status = render_running;
+	bins_used = prepare_tiles(*world, cam, image, settings, bins);
+}
+
+inline void Render_job_state::run_task(int tile)
+{
+	status = render_running;
+	render_tile(*world, bins_used, cam, image, settings, tile);
+}
+
+// Rate limited progress, one callback at a time per job
+inline void Render_job_state::task_finished(std::unique_lock<std::mutex>& lock)
+{
+	const clock::time_point now = clock::now();
+	if (settings.progress && !reporting && tasks_done < task_count &&
+		std::chrono::duration<double, std::milli>(now - last_progress).count() >= settings.progress_interval_ms)
+	{
+		reporting = true;
+		last_progress = now;
+		lock.unlock();
+		settings.progress(snapshot());
+		lock.lock();
+		reporting = false;
+	}
+}
+
+inline void Render_job_state::finish()
+{
+	const Render_status final_status = tasks_done == task_count ? render_finished : render_cancelled;
+	if (settings.progress)
+	{
+		Render_progress progress = snapshot();
+		progress.status = final_status;
+		settings.progress(progress);
+	}
+	{
+		std::lock_guard<std::mutex> done_lock(done_mutex);
+		status = final_status;
+	}
+	done.notify_all();
+}
+
+inline Render_job Render_pool::submit(const Hittable& world, const Camera& cam, const Render_job_settings& settings)
+{
+	std::shared_ptr<Render_job_state> job = std::make_shared<Render_job_state>(this, world, cam, settings);
+	enqueue(job);
+	return Render_job(job);
+}
+
+// Start rendering on the shared pool and return right away. The world has to stay alive until the job is over
+inline Render_job render(const Hittable& world, const Camera& cam, const Render_job_settings& settings)
+{
+	return Render_pool::shared().submit(world, cam, settings);
+}
+
+#endif
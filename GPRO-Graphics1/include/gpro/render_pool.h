@@ -0,0 +1,337 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	render_pool.h
+	A header which stores the worker threads every parallel part of the renderer shares, so running several of them at once
+	(a blocking render next to queued render jobs, or the denoiser next to a preview) never starts more threads than there are cores.
+
+	The pool runs Pool_jobs: a job is a number of tasks, with an optional setup step before the first one. Workers take one task at a time
+	from the job with the highest priority (the oldest one on a tie). render_job.h queues render jobs on it, and run_tasks lets a blocking
+	call queue its tasks and work on them from the calling thread too, so it never has to wait for a worker to come free.
+	Waiting for a queued job works the same way (work_on), so a callback or task running on a worker can wait for another job
+	even when every worker is busy
+*/
+#pragma once
+#ifndef RENDER_POOL_H
+#define RENDER_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Hittable;
+class Camera;
+struct Render_job_settings;
+class Render_job;
+class Render_pool;
+
+// Turns a requested thread count into a real one
+inline int resolve_thread_count(int requested)
+{
+	if (requested > 0)
+	{
+		return requested;
+	}
+	int hardware = int(std::thread::hardware_concurrency());
+	return hardware > 0 ? hardware : 1;
+}
+
+// Something the pool can work on, split into task_count tasks. The fields under "pool" are guarded by the pool's mutex
+struct Pool_job {
+	Pool_job(Render_pool* owner, int count, int max_workers, int job_priority, bool needs_prepare)
+		: pool(owner), task_count(count), worker_limit(max_workers), sequence(0), priority(job_priority), preparing(false), ready(!needs_prepare),
+		finishing(false), caller_finishes(false), next_task(0), active_workers(0), tasks_done(0), cancel_requested(false) {}
+	virtual ~Pool_job() {};
+
+	virtual void prepare() {};				// Runs once before the first task, without the mutex
+	virtual void run_task(int task) = 0;	// Runs one task, without the mutex
+	virtual void task_finished(std::unique_lock<std::mutex>& lock) { (void)lock; };	// Runs with the mutex held after every task
+	virtual void finish() {};				// Runs once when every task is done or the job was cancelled, without the mutex
+
+	Render_pool* pool;		// Pool the job runs on
+	int task_count;			// Tasks in the job
+	int worker_limit;		// Most workers on the job at once, 0 for any
+	long long sequence;		// Order the jobs were submitted in
+
+	// Pool
+	int priority;			// Current priority
+	bool preparing;			// A worker is running prepare
+	bool ready;				// prepare is done
+	bool finishing;			// A worker is running finish
+	bool caller_finishes;	// The thread that queued the job works on it and takes it off the queue (run_tasks)
+	int next_task;			// Next task to hand out
+	int active_workers;		// Workers on this job right now
+
+	std::atomic<int> tasks_done;			// Tasks finished so far
+	std::atomic<bool> cancel_requested;		// Checked before every task
+};
+
+// Worker threads shared by every job
+class Render_pool {
+	public:
+		explicit Render_pool(int thread_count = 0);	// Ctor, 0 starts one worker per hardware thread
+		~Render_pool();								// Cancels the jobs that are left and stops the workers
+
+		static Render_pool& shared();	// The pool render() uses
+
+		Render_job submit(const Hittable& world, const Camera& cam, const Render_job_settings& settings);	// Queue a render job (render_job.h)
+		void run_tasks(Pool_job& job);	// Queue job, work on it from this thread too and return when every task is done.
+										// The calling thread counts towards the job's worker_limit while it runs a task
+
+		// Work on a queued job from this thread until it is over or being finished, returns false if deadline came first
+		bool work_on(const std::shared_ptr<Pool_job>& job, const std::chrono::steady_clock::time_point* deadline = nullptr);
+		int worker_count() const { return int(workers.size()); }	// Number of worker threads
+
+	private:
+		friend class Render_job;
+
+		// What a worker can do next for a job
+		enum Work { work_none, work_prepare, work_task, work_finish };
+
+		void enqueue(const std::shared_ptr<Pool_job>& job);
+		Work work_for(const Pool_job& job) const;
+		std::shared_ptr<Pool_job> pick(Work& work);
+		void worker();
+		void run(const std::shared_ptr<Pool_job>& job, Work work, std::unique_lock<std::mutex>& lock);
+		void run_one_task(Pool_job& job, std::unique_lock<std::mutex>& lock);
+		void notify() { std::lock_guard<std::mutex> lock(mutex); work_ready.notify_all(); }
+		void set_priority(Pool_job& job, int priority);
+
+		std::mutex mutex;								// Guards everything below and the pool fields of every job
+		std::condition_variable work_ready;				// Signalled when a worker may have something new to do
+		std::vector<std::shared_ptr<Pool_job>> jobs;	// Jobs that are not over yet
+		std::vector<std::thread> workers;				// Worker threads
+		long long next_sequence;						// Sequence number of the next job
+		bool stopping;									// Set by the dtor
+};
+
+inline Render_pool::Render_pool(int thread_count) : next_sequence(0), stopping(false)
+{
+	thread_count = resolve_thread_count(thread_count);
+	for (int t = 0; t < thread_count; ++t)
+	{
+		workers.emplace_back([this]() { worker(); });
+	}
+}
+
+inline Render_pool::~Render_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		for (size_t k = 0; k < jobs.size(); ++k)
+		{
+			jobs[k]->cancel_requested = true;
+		}
+		work_ready.notify_all();
+	}
+	for (size_t t = 0; t < workers.size(); ++t)
+	{
+		workers[t].join();
+	}
+}
+
+inline Render_pool& Render_pool::shared()
+{
+	static Render_pool pool;
+	return pool;
+}
+
+inline void Render_pool::enqueue(const std::shared_ptr<Pool_job>& job)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	job->sequence = next_sequence++;
+	if (stopping)
+	{
+		job->cancel_requested = true;
+	}
+	jobs.push_back(job);
+	work_ready.notify_all();
+}
+
+// The caller takes any task no worker has started, so the tasks get done even when every worker is busy with other jobs.
+// The job does not own its tasks' data, so it is only taken off the queue once no worker is on it any more
+inline void Render_pool::run_tasks(Pool_job& job)
+{
+	// The pool only holds a reference, the job lives on the caller's stack until this returns
+	std::shared_ptr<Pool_job> queued(&job, [](Pool_job*) {});
+	job.caller_finishes = true;
+	job.ready = true;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	job.sequence = next_sequence++;
+	jobs.push_back(queued);
+	work_ready.notify_all();
+	while (job.next_task < job.task_count)
+	{
+		run_one_task(job, lock);
+	}
+	work_ready.wait(lock, [&]() { return job.active_workers == 0; });
+	jobs.erase(std::find(jobs.begin(), jobs.end(), queued));
+	work_ready.notify_all();	// Workers that are stopping wait for the queue to empty
+}
+
+// Takes whatever work the job has, finish included, so the job gets done even if no worker is free.
+// Returns once a thread has started finishing it, the caller still has to wait for finish to return
+inline bool Render_pool::work_on(const std::shared_ptr<Pool_job>& job, const std::chrono::steady_clock::time_point* deadline)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!job->finishing)
+	{
+		const Work work = work_for(*job);
+		if (work != work_none)
+		{
+			run(job, work, lock);
+		}
+		else if (!deadline)
+		{
+			work_ready.wait(lock);
+		}
+		else if (work_ready.wait_until(lock, *deadline) == std::cv_status::timeout && !job->finishing)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+inline void Render_pool::set_priority(Pool_job& job, int priority)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	job.priority = priority;
+}
+
+// Finishing comes first, then the setup step, then tasks while the job is under its worker limit
+inline Render_pool::Work Render_pool::work_for(const Pool_job& job) const
+{
+	const bool over = job.cancel_requested || job.tasks_done == job.task_count;
+	if (over || (job.caller_finishes && job.next_task >= job.task_count))
+	{
+		return (job.active_workers == 0 && !job.finishing && !job.caller_finishes) ? work_finish : work_none;
+	}
+	if (job.worker_limit > 0 && job.active_workers >= job.worker_limit)
+	{
+		return work_none;
+	}
+	if (!job.ready)
+	{
+		return job.preparing ? work_none : work_prepare;
+	}
+	return job.next_task < job.task_count ? work_task : work_none;
+}
+
+// The job with the highest priority that has work, the oldest one on a tie. Called with the mutex held
+inline std::shared_ptr<Pool_job> Render_pool::pick(Work& work)
+{
+	std::shared_ptr<Pool_job> best;
+	work = work_none;
+	for (size_t k = 0; k < jobs.size(); ++k)
+	{
+		const Work job_work = work_for(*jobs[k]);
+		if (job_work == work_none)
+		{
+			continue;
+		}
+		if (job_work == work_finish)
+		{
+			work = job_work;
+			return jobs[k];
+		}
+		if (!best || jobs[k]->priority > best->priority || (jobs[k]->priority == best->priority && jobs[k]->sequence < best->sequence))
+		{
+			best = jobs[k];
+			work = job_work;
+		}
+	}
+	return best;
+}
+
+inline void Render_pool::worker()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		Work work = work_none;
+		std::shared_ptr<Pool_job> job = pick(work);
+		if (job)
+		{
+			run(job, work, lock);
+		}
+		else if (stopping && jobs.empty())
+		{
+			return;
+		}
+		else
+		{
+			work_ready.wait(lock);
+		}
+	}
+}
+
+// Do one piece of work for a job. Called with the mutex held, drops it while the job runs
+inline void Render_pool::run(const std::shared_ptr<Pool_job>& job, Work work, std::unique_lock<std::mutex>& lock)
+{
+	if (work == work_finish)
+	{
+		job->finishing = true;
+		jobs.erase(std::find(jobs.begin(), jobs.end(), job));
+		lock.unlock();
+		job->finish();
+		lock.lock();
+		return;
+	}
+
+	if (work == work_prepare)
+	{
+		++job->active_workers;
+		job->preparing = true;
+		lock.unlock();
+		job->prepare();
+		lock.lock();
+		job->ready = true;
+		--job->active_workers;
+		work_ready.notify_all();
+		return;
+	}
+
+	run_one_task(*job, lock);
+}
+
+// Run the next task of a job. Called with the mutex held, drops it while the task runs
+inline void Render_pool::run_one_task(Pool_job& job, std::unique_lock<std::mutex>& lock)
+{
+	++job.active_workers;
+	const int task = job.next_task++;
+	lock.unlock();
+	job.run_task(task);
+	++job.tasks_done;
+	lock.lock();
+	job.task_finished(lock);
+
+	--job.active_workers;
+	if (job.active_workers == 0 || job.worker_limit > 0)
+	{
+		work_ready.notify_all();	// The job may be over, or a worker slot opened up
+	}
+}
+
+#endif
@@ -0,0 +1,111 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	scene.h
+	A header which stores functions that fill a Hittable_list with a scene.
+	build_default_scene is the two-sphere scene from the test console, build_scene makes bigger scenes procedurally so renders can be timed at scale.
+	baked_default_scene is the same two spheres built at compile time. baked_row_scene has more spheres than Baked_unroll_limit,
+	so it goes through the baked BVH, and build_row_scene puts the same spheres in a Hittable_list to check it against
+*/
+#pragma once
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "mathconstants.h"
+#include "hittable_list.h"
+#include "sphere.h"
+#include "camera.h"
+#include "baked_scene.h"
+
+#include <cmath>
+
+// Add the two spheres from the test console to the world
+inline void build_default_scene(Hittable_list& world)
+{
+	world.add(make_shared<Sphere>(point3(0, 0, -1), 0.5f));			// Create a small sphere at the center of the viewport with a radius of .5
+	world.add(make_shared<Sphere>(point3(0, -100.5, -1), 100.0f));	// Create a large sphere super far outside the viewport (-100 y) with a radius of 100
+}
+
+// The two spheres from the test console as a compile-time scene, it lives in the program's read-only data and needs no setup
+constexpr Baked_sphere default_scene_spheres[2] = {
+	Baked_sphere(point3(0, 0, -1), 0.5f),			// Small sphere at the center of the viewport
+	Baked_sphere(point3(0, -100.5f, -1), 100.0f)	// Large ground sphere
+};
+constexpr Baked_scene<2> baked_default_scene(default_scene_spheres);
+static_assert(baked_default_scene.node_count == 1 && baked_default_scene.nodes[0].box_min.y == -200.5f, "The default scene should bake into a single leaf");
+
+// The ground sphere and two rows of small spheres in front of the default camera, some of them overlapping on screen
+constexpr Baked_sphere row_scene_spheres[12] = {
+	Baked_sphere(point3(0, -100.5f, -1), 100.0f),	// Large ground sphere
+	Baked_sphere(point3(-1.6f, -0.2f, -1.8f), 0.3f),
+	Baked_sphere(point3(-0.9f, -0.1f, -1.6f), 0.4f),
+	Baked_sphere(point3(-0.2f, -0.25f, -1.4f), 0.25f),
+	Baked_sphere(point3(0.5f, 0.0f, -1.7f), 0.5f),
+	Baked_sphere(point3(1.3f, -0.15f, -1.5f), 0.35f),
+	Baked_sphere(point3(2.0f, -0.1f, -2.0f), 0.4f),
+	Baked_sphere(point3(-1.9f, 0.6f, -3.0f), 0.5f),
+	Baked_sphere(point3(-0.8f, 0.5f, -2.6f), 0.45f),
+	Baked_sphere(point3(0.1f, 0.7f, -3.2f), 0.6f),
+	Baked_sphere(point3(1.1f, 0.55f, -2.8f), 0.5f),
+	Baked_sphere(point3(2.2f, 0.8f, -3.5f), 0.7f)
+};
+constexpr Baked_scene<12> baked_row_scene(row_scene_spheres);
+static_assert(Baked_unroll_limit < 12 && baked_row_scene.node_count > 1, "The row scene should be big enough to bake into a BVH");
+
+// Add the spheres of baked_row_scene to the world, in the same order as row_scene_spheres
+inline void build_row_scene(Hittable_list& world)
+{
+	for (int k = 0; k < 12; ++k)
+	{
+		world.add(make_shared<Sphere>(row_scene_spheres[k].center, row_scene_spheres[k].radius));
+	}
+}
+
+// Fill the world with sphere_count spheres. 2 (or less) gives the default scene,
+// otherwise the ground sphere is kept and the rest are small spheres spread over a jittered grid that covers the camera's view
+inline void build_scene(Hittable_list& world, int sphere_count, uint32_t seed = 1u, const Camera& cam = Camera())
+{
+	if (sphere_count <= 2)
+	{
+		build_default_scene(world);
+		return;
+	}
+
+	world.objects.reserve(world.objects.size() + size_t(sphere_count));
+	world.add(make_shared<Sphere>(point3(0, -100.5, -1), 100.0f));	// Keep the ground sphere
+
+	const int small_count = sphere_count - 1;
+	const int grid = int(std::ceil(std::sqrt(float(small_count))));	// Cells per side of the grid
+	const float cell = 1.0f / float(grid);							// Size of one cell in viewport units (0 to 1)
+	const vec3 forward = cam.lower_left_corner - cam.origin;			// From the camera to the lower left corner, the same direction get_ray starts from
+
+	Random rng(seed);
+	for (int k = 0; k < small_count; ++k)
+	{
+		// Pick a random point in this sphere's cell and a random depth, then push it out along the camera ray
+		float u = (float(k % grid) + rng.next_float(0.1f, 0.9f)) * cell;
+		float v = (float(k / grid) + rng.next_float(0.1f, 0.9f)) * cell;
+		float depth = rng.next_float(1.5f, 3.0f);
+		point3 center = cam.origin + (forward + (cam.horizontal * u) + (cam.vertical * v)) * depth;
+
+		// Scale the radius with depth so every sphere covers about the same part of its cell on screen
+		float radius = 0.4f * cell * cam.vertical.length() * depth * rng.next_float(0.5f, 1.0f);
+		world.add(make_shared<Sphere>(center, radius));
+	}
+}
+
+#endif
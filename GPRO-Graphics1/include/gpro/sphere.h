@@ -34,13 +34,14 @@ class Sphere : public Hittable {
 		Sphere(point3 cen, float r) : center(cen), radius(r) {}; // Ctor with values
 
 		virtual bool hit(const ray& r, float tmin, float tmax, hit_record& rec) const override; // Override the hit function from Hittable
+		virtual bool bounding_box(point3& box_min, point3& box_max) const override; // Override the bounding_box function from Hittable
 
 		point3 center;	// Center of the sphere
 		float radius;	// Radius of the sphere
 };
 
-// Check to see if a ray hit a sphere object
-bool Sphere::hit(const ray& r, float tmin, float tmax, hit_record& rec) const
+// Check to see if a ray hit the sphere with this center and radius. Shared by Sphere and the compile-time scenes so both give the same hits
+inline bool hit_sphere(const point3& center, float radius, const ray& r, float tmin, float tmax, hit_record& rec)
 {
 	// Calculate the discriminate from the ray
 	vec3 oc = r.origin() - center;
@@ -79,4 +80,18 @@ bool Sphere::hit(const ray& r, float tmin, float tmax, hit_record& rec) const
 	return false;
 }
 
+// Check to see if a ray hit a sphere object
+bool Sphere::hit(const ray& r, float tmin, float tmax, hit_record& rec) const
+{
+	return hit_sphere(center, radius, r, tmin, tmax, rec);
+}
+
+// Gets the box around the sphere
+bool Sphere::bounding_box(point3& box_min, point3& box_max) const
+{
+	box_min = center - vec3(radius, radius, radius);
+	box_max = center + vec3(radius, radius, radius);
+	return true;
+}
+
 #endif
\ No newline at end of file
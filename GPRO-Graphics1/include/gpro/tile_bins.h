@@ -0,0 +1,256 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	tile_bins.h
+	A header which stores per-tile frustum culling for primary rays. Before a frame, every object's bounding box is projected through the camera
+	onto the viewport and the object is added to each screen tile its projection touches. A primary ray then only tests the objects of its own tile.
+	Each tile keeps its objects in list order, so the hits (and the pixels) are exactly the same as testing the whole Hittable_list.
+	The bins only hold for rays that start at the camera origin and go through the viewport, not for bounces
+*/
+#pragma once
+#ifndef TILE_BINS_H
+#define TILE_BINS_H
+
+#include "hittable_list.h"
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// How much of the viewport a box can show up on
+enum Screen_coverage {
+	coverage_none,	// Entirely behind the camera, primary rays can never hit it
+	coverage_rect,	// Inside the rectangle [u0, u1] x [v0, v1]
+	coverage_all	// Around or right in front of the camera, could be anywhere
+};
+
+// Projects the corners of a box onto the viewport and gets the rectangle around them in the u/v coordinates of Camera::get_ray
+inline Screen_coverage project_bounds(const Camera& cam, const point3& box_min, const point3& box_max, float& u0, float& v0, float& u1, float& v1)
+{
+	const vec3 to_viewport = cam.lower_left_corner - cam.origin;
+	vec3 forward = cross(cam.horizontal, cam.vertical);	// Normal of the viewport, flipped to point away from the camera
+	if (dot(forward, to_viewport) < 0.0f)
+	{
+		forward *= -1.0f;
+	}
+	const float viewport_depth = dot(to_viewport, forward);
+
+	// Dual axes so u and v come out right even if horizontal and vertical are not perpendicular
+	vec3 u_axis = cross(cam.vertical, forward);
+	vec3 v_axis = cross(forward, cam.horizontal);
+	u_axis *= 1.0f / dot(cam.horizontal, u_axis);
+	v_axis *= 1.0f / dot(cam.vertical, v_axis);
+
+	int behind = 0;
+	bool first_corner = true;
+	for (int k = 0; k < 8; ++k)
+	{
+		const point3 corner(k & 1 ? box_max.x : box_min.x, k & 2 ? box_max.y : box_min.y, k & 4 ? box_max.z : box_min.z);
+		const vec3 offset = corner - cam.origin;
+		const float depth = dot(offset, forward);
+		if (depth <= 0.0f)
+		{
+			++behind;
+			continue;
+		}
+		if (depth < viewport_depth * 1.0e-4f)
+		{
+			return coverage_all;	// So close to the camera plane that the projection blows up
+		}
+
+		// Slide the corner along its ray from the camera onto the viewport
+		const vec3 on_viewport = offset * (viewport_depth / depth) - to_viewport;
+		const float u = dot(on_viewport, u_axis);
+		const float v = dot(on_viewport, v_axis);
+		u0 = first_corner ? u : std::min(u0, u);
+		v0 = first_corner ? v : std::min(v0, v);
+		u1 = first_corner ? u : std::max(u1, u);
+		v1 = first_corner ? v : std::max(v1, v);
+		first_corner = false;
+	}
+
+	if (behind == 8)
+	{
+		return coverage_none;
+	}
+	return behind == 0 ? coverage_rect : coverage_all;	// A box crossing the camera plane can cover any part of the viewport
+}
+
+// The objects one tile has to test, a view into Tile_bins
+class Tile_candidates : public Hittable {
+	public:
+		Tile_candidates() : first(nullptr), last(nullptr) {};	// Default ctor
+		Tile_candidates(const Hittable* const* begin, const Hittable* const* end) : first(begin), last(end) {};	// Ctor with values
+
+		virtual bool hit(const ray& r, float tmin, float tmax, hit_record& rec) const override;	// Override the hit function from Hittable
+
+		size_t size() const { return size_t(last - first); }	// Number of objects in the tile
+
+		const Hittable* const* first;	// First object of the tile
+		const Hittable* const* last;	// One past the last object of the tile
+};
+
+// Check to see if a ray hit one of the tile's objects, the same loop as Hittable_list::hit
+inline bool Tile_candidates::hit(const ray& r, float tmin, float tmax, hit_record& rec) const
+{
+	hit_record temp_rec;
+	bool hit_anything = false;
+	float closest_so_far = tmax;
+
+	for (const Hittable* const* object = first; object != last; ++object)
+	{
+		if ((*object)->hit(r, tmin, closest_so_far, temp_rec))
+		{
+			hit_anything = true;
+			closest_so_far = temp_rec.t;
+			rec = temp_rec;
+		}
+	}
+	return hit_anything;
+}
+
+// The objects of a Hittable_list sorted into the screen tiles of one image. Tiles are numbered
+// tile_y * tiles_x + tile_x, the same way render numbers them. The world has to outlive the bins
+class Tile_bins {
+	public:
+		Tile_bins() : width(0), height(0), tile_size(1), tiles_x(0), tiles_y(0) {};	// Default ctor
+
+		void build(const Hittable_list& world, const Camera& cam, int image_width, int image_height, int tile_pixels);	// Bin the objects for one frame
+
+		const Tile_candidates& tile(int index) const { return tiles[size_t(index)]; }	// Objects of tile index
+		const Tile_candidates& tile_at(int i, int j) const { return tiles[size_t((j / tile_size) * tiles_x + i / tile_size)]; }	// Objects of the tile pixel (i, j) is in
+		double average_candidates() const;	// Objects a primary ray tests on average
+
+		int width;		// Width of the image in pixels
+		int height;		// Height of the image in pixels
+		int tile_size;	// Width and height of a tile in pixels
+		int tiles_x;	// Tiles per row
+		int tiles_y;	// Tiles per column
+
+	private:
+		std::vector<const Hittable*> candidates;	// The objects of every tile, one tile after the other
+		std::vector<Tile_candidates> tiles;			// Where each tile's objects are in candidates
+};
+
+// Two passes over the objects (count, then fill) keep the cost at O(objects + entries) and each tile in list order
+inline void Tile_bins::build(const Hittable_list& world, const Camera& cam, int image_width, int image_height, int tile_pixels)
+{
+	width = image_width;
+	height = image_height;
+	tile_size = std::max(tile_pixels, 1);
+	tiles_x = (width + tile_size - 1) / tile_size;
+	tiles_y = (height + tile_size - 1) / tile_size;
+	const size_t object_count = world.objects.size();
+
+	// Tiles each object covers as [x0, x1] x [y0, y1], x0 > x1 when it covers none
+	std::vector<int> rects(object_count * 4);
+	std::vector<size_t> offsets(size_t(tiles_x) * size_t(tiles_y) + 1, 0);
+	for (size_t k = 0; k < object_count; ++k)
+	{
+		int* rect = &rects[k * 4];
+		rect[0] = 0;
+		rect[1] = 0;
+		rect[2] = tiles_x - 1;
+		rect[3] = tiles_y - 1;
+
+		point3 box_min, box_max;
+		float u0 = 0.0f, v0 = 0.0f, u1 = 0.0f, v1 = 0.0f;
+		const Screen_coverage coverage = (world.objects[k]->bounding_box(box_min, box_max) && width > 1 && height > 1)
+			? project_bounds(cam, box_min, box_max, u0, v0, u1, v1) : coverage_all;
+		if (coverage == coverage_none)
+		{
+			rect[0] = 1;
+			rect[2] = 0;
+		}
+		else if (coverage == coverage_rect)
+		{
+			// Pixel i traces u = i / (width - 1), jittered samples go half a pixel further. One more pixel covers rounding
+			const float x0 = std::max(std::floor(u0 * float(width - 1) - 1.5f), -1.0f);
+			const float x1 = std::min(std::ceil(u1 * float(width - 1) + 1.5f), float(width));
+			const float y0 = std::max(std::floor(v0 * float(height - 1) - 1.5f), -1.0f);
+			const float y1 = std::min(std::ceil(v1 * float(height - 1) + 1.5f), float(height));
+			if (x1 < 0.0f || y1 < 0.0f || x0 > float(width - 1) || y0 > float(height - 1))
+			{
+				rect[0] = 1;
+				rect[2] = 0;
+			}
+			else
+			{
+				rect[0] = std::max(int(x0), 0) / tile_size;
+				rect[1] = std::max(int(y0), 0) / tile_size;
+				rect[2] = std::min(int(x1), width - 1) / tile_size;
+				rect[3] = std::min(int(y1), height - 1) / tile_size;
+			}
+		}
+
+		for (int ty = rect[1]; rect[0] <= rect[2] && ty <= rect[3]; ++ty)
+		{
+			for (int tx = rect[0]; tx <= rect[2]; ++tx)
+			{
+				++offsets[size_t(ty * tiles_x + tx) + 1];
+			}
+		}
+	}
+
+	for (size_t t = 1; t < offsets.size(); ++t)
+	{
+		offsets[t] += offsets[t - 1];
+	}
+
+	candidates.resize(offsets.back());
+	std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+	for (size_t k = 0; k < object_count; ++k)
+	{
+		const int* rect = &rects[k * 4];
+		for (int ty = rect[1]; rect[0] <= rect[2] && ty <= rect[3]; ++ty)
+		{
+			for (int tx = rect[0]; tx <= rect[2]; ++tx)
+			{
+				candidates[cursor[size_t(ty * tiles_x + tx)]++] = world.objects[k].get();
+			}
+		}
+	}
+
+	const Hittable* const* base = candidates.data();
+	tiles.resize(offsets.size() - 1);
+	for (size_t t = 0; t < tiles.size(); ++t)
+	{
+		tiles[t] = Tile_candidates(base + offsets[t], base + offsets[t + 1]);
+	}
+}
+
+// Weighs each tile's object count by its pixels, edge tiles can be smaller
+inline double Tile_bins::average_candidates() const
+{
+	if (width <= 0 || height <= 0)
+	{
+		return 0.0;
+	}
+	double tests = 0.0;
+	for (int ty = 0; ty < tiles_y; ++ty)
+	{
+		for (int tx = 0; tx < tiles_x; ++tx)
+		{
+			const int pixels = (std::min(tile_size, width - tx * tile_size)) * (std::min(tile_size, height - ty * tile_size));
+			tests += double(pixels) * double(tile(ty * tiles_x + tx).size());
+		}
+	}
+	return tests / (double(width) * double(height));
+}
+
+#endif
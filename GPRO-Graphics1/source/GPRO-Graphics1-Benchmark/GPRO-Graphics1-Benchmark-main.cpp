@@ -0,0 +1,710 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	GPRO-Graphics1-Benchmark-main.cpp
+	Main entry point for the scene-scale benchmark.
+
+	Builds scenes from the two-sphere setup up to a million spheres and renders each one at every requested width and thread count.
+	Every run records wall time, rays/sec, its own peak RSS (Linux only) and a checksum/PSNR against a golden image stored in the
+	golden folder next to this file, made by the one-thread render_reference path, so a speedup can not change pixels without being noticed. With --cull, a moved and tilted camera is also rendered with and without
+	culling to check that both give the same pixels. The compile-time baked_row_scene, big enough to go through the baked BVH, is also
+	rendered at every width and checked against a golden image of the same spheres in a Hittable_list. Results are written as CSV and/or
+	JSON and can be compared against an older CSV to flag slowdowns.
+
+	Usage: GPRO-Graphics1-Benchmark [options]
+		--spheres 2,1000,100000,1000000	scene sizes to build
+		--widths 100,400				image widths (height keeps the 16:9 aspect ratio)
+		--threads 1,0					thread counts (0 = every hardware thread). Renders run on the shared pool, so counts above its workers
+										plus the calling thread are lowered to that and the rows record the count that really ran
+		--repeat 1						renders per run, the fastest one is kept
+		--max-work 10000000000			cost cap for renders that test every sphere for every ray. A run with no golden image is skipped
+										when render_reference would go over it (spheres * pixels), a run with --cull 0 when render on every
+										hardware thread would (spheres * pixels / hardware threads). With --cull the moved camera check is
+										skipped instead and the run itself still goes ahead
+		--seed 1						seed for the procedural scenes
+		--golden-dir dir				where golden images are read from (default: the golden folder next to this file). A missing one is a failure
+		--update-golden					render missing golden images with render_reference and store them instead of failing
+		--csv file / --json file		where to write the results (CSV goes to std::cout if neither is given)
+		--compare file					older CSV to compare rays/sec against
+		--threshold 0.10				allowed slowdown before a run counts as a regression
+		--budgets 1,5,20				also run the progressive renderer with these time budgets (ms)
+		--progressive-csv file			where to write the quality-versus-time rows of --budgets (default std::cerr)
+		--denoise-spp 4					also render with this many samples per pixel, denoise it and compare both against --reference-spp.
+										Fails if the denoised image is not closer to the reference (above one sample per pixel)
+		--reference-spp 64				samples per pixel of the image the denoiser is compared against
+		--denoise-csv file				where to write the rows of --denoise-spp (default std::cerr)
+		--cull 1						bin the spheres into screen tiles before rendering (0 tests every sphere for every ray)
+		--jobs 4						also run this many render jobs at once on the shared worker pool and check each one against the golden image
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gpro/mathconstants.h"
+#include "gpro/hittable_list.h"
+#include "gpro/sphere.h"
+#include "gpro/camera.h"
+#include "gpro/image.h"
+#include "gpro/render.h"
+#include "gpro/scene.h"
+#include "gpro/progressive.h"
+#include "gpro/denoise.h"
+#include "gpro/tile_bins.h"
+#include "gpro/render_job.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// One row of the results
+struct Bench_result {
+	int spheres = 0;
+	int width = 0;
+	int height = 0;
+	int threads = 0;
+	double seconds = 0.0;
+	double rays_per_sec = 0.0;
+	size_t peak_rss_bytes = 0;			// Most memory resident during this run, the scene included (0 where that can not be measured)
+	double binning_ms = 0.0;			// Time to bin the spheres into tiles (0 without --cull)
+	double tests_per_ray = 0.0;			// Spheres a primary ray is tested against on average
+	uint64_t checksum = 0;
+	uint64_t golden_checksum = 0;
+	float psnr_db = 0.0f;
+	bool pixels_match = false;
+};
+
+// One point of a quality-versus-time curve from the progressive renderer
+struct Progressive_row {
+	int spheres = 0;
+	int width = 0;
+	int height = 0;
+	int threads = 0;
+	double budget_ms = 0.0;
+	double elapsed_ms = 0.0;
+	int finest_block = 0;
+	double traced_fraction = 0.0;
+	float psnr_db = 0.0f;
+	bool pixels_match = false;
+};
+
+// Low sample count plus denoiser against a high sample count render
+struct Denoise_row {
+	int spheres = 0;
+	int width = 0;
+	int height = 0;
+	int threads = 0;
+	int low_spp = 0;
+	int reference_spp = 0;
+	double low_ms = 0.0;			// Render time with low_spp (feature buffers included)
+	double denoise_ms = 0.0;		// Denoiser time
+	double denoise_ms_per_mpixel = 0.0;
+	double reference_ms = 0.0;		// Render time with reference_spp
+	float low_psnr_db = 0.0f;		// Low sample count render against the reference
+	float denoised_psnr_db = 0.0f;	// Denoised render against the reference
+};
+
+// Starts a new peak memory measurement: on Linux writing 5 to clear_refs sets the high-water mark (VmHWM) back to what is resident now.
+// Windows and macOS can not reset their peak, which only grows over the whole process, so there this returns false and no peak is recorded
+bool reset_peak_rss()
+{
+#ifdef __linux__
+	std::ofstream clear_refs("/proc/self/clear_refs");
+	return bool(clear_refs << '5' << std::flush);
+#else
+	return false;
+#endif
+}
+
+// Gets the most memory resident since reset_peak_rss, 0 if it can not be read
+size_t peak_rss_bytes()
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, 6, "VmHWM:") == 0)
+		{
+			return size_t(strtoull(line.c_str() + 6, nullptr, 10)) * 1024;	// In kilobytes
+		}
+	}
+	return 0;
+}
+
+// Turns "1,2,3" into {1, 2, 3}
+std::vector<int> parse_int_list(const char* text)
+{
+	std::vector<int> values;
+	std::stringstream stream(text);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		if (!item.empty())
+		{
+			values.push_back(atoi(item.c_str()));
+		}
+	}
+	return values;
+}
+
+std::string checksum_to_string(uint64_t checksum)
+{
+	std::ostringstream out;
+	out << std::hex << std::setw(16) << std::setfill('0') << checksum;
+	return out.str();
+}
+
+std::string result_key(int spheres, int width, int height, int threads)
+{
+	std::ostringstream out;
+	out << spheres << '/' << width << 'x' << height << '/' << threads;
+	return out.str();
+}
+
+void write_csv(std::ostream& out, const std::vector<Bench_result>& results)
+{
+	out << "spheres,width,height,threads,seconds,rays_per_sec,peak_rss_bytes,binning_ms,tests_per_ray,checksum,golden_checksum,psnr_db,pixels_match\n";
+	for (size_t k = 0; k < results.size(); ++k)
+	{
+		const Bench_result& r = results[k];
+		out << r.spheres << ',' << r.width << ',' << r.height << ',' << r.threads << ','
+			<< r.seconds << ',' << r.rays_per_sec << ',' << r.peak_rss_bytes << ',' << r.binning_ms << ',' << r.tests_per_ray << ','
+			<< checksum_to_string(r.checksum) << ',' << checksum_to_string(r.golden_checksum) << ','
+			<< (r.pixels_match ? std::string("inf") : std::to_string(r.psnr_db)) << ','
+			<< (r.pixels_match ? 1 : 0) << '\n';
+	}
+}
+
+void write_json(std::ostream& out, const std::vector<Bench_result>& results)
+{
+	out << "[\n";
+	for (size_t k = 0; k < results.size(); ++k)
+	{
+		const Bench_result& r = results[k];
+		out << "  { \"spheres\": " << r.spheres << ", \"width\": " << r.width << ", \"height\": " << r.height
+			<< ", \"threads\": " << r.threads << ", \"seconds\": " << r.seconds << ", \"rays_per_sec\": " << r.rays_per_sec
+			<< ", \"peak_rss_bytes\": " << r.peak_rss_bytes << ", \"binning_ms\": " << r.binning_ms << ", \"tests_per_ray\": " << r.tests_per_ray
+			<< ", \"checksum\": \"" << checksum_to_string(r.checksum) << "\", \"golden_checksum\": \"" << checksum_to_string(r.golden_checksum) << '"'
+			<< ", \"psnr_db\": " << (r.pixels_match ? std::string("null") : std::to_string(r.psnr_db))
+			<< ", \"pixels_match\": " << (r.pixels_match ? "true" : "false") << " }"
+			<< (k + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "]\n";
+}
+
+void write_progressive_csv(std::ostream& out, const std::vector<Progressive_row>& rows)
+{
+	out << "spheres,width,height,threads,budget_ms,elapsed_ms,finest_block,traced_fraction,psnr_db\n";
+	for (size_t k = 0; k < rows.size(); ++k)
+	{
+		const Progressive_row& r = rows[k];
+		out << r.spheres << ',' << r.width << ',' << r.height << ',' << r.threads << ','
+			<< r.budget_ms << ',' << r.elapsed_ms << ',' << r.finest_block << ',' << r.traced_fraction << ','
+			<< (r.pixels_match ? std::string("inf") : std::to_string(r.psnr_db)) << '\n';
+	}
+}
+
+void write_denoise_csv(std::ostream& out, const std::vector<Denoise_row>& rows)
+{
+	out << "spheres,width,height,threads,low_spp,reference_spp,low_ms,denoise_ms,denoise_ms_per_mpixel,reference_ms,low_psnr_db,denoised_psnr_db\n";
+	for (size_t k = 0; k < rows.size(); ++k)
+	{
+		const Denoise_row& r = rows[k];
+		out << r.spheres << ',' << r.width << ',' << r.height << ',' << r.threads << ',' << r.low_spp << ',' << r.reference_spp << ','
+			<< r.low_ms << ',' << r.denoise_ms << ',' << r.denoise_ms_per_mpixel << ',' << r.reference_ms << ','
+			<< r.low_psnr_db << ',' << r.denoised_psnr_db << '\n';
+	}
+}
+
+// Milliseconds since start
+double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Reads the rays/sec of every run in an older CSV, returns false if the file can not be read
+bool read_baseline(const char* path, std::map<std::string, double>& rays_per_sec)
+{
+	std::ifstream in(path);
+	std::string line;
+	if (!in || !std::getline(in, line))
+	{
+		return false;
+	}
+
+	// Find the columns by name so older files with extra columns still work
+	std::vector<std::string> header;
+	std::stringstream header_stream(line);
+	std::string cell;
+	while (std::getline(header_stream, cell, ','))
+	{
+		header.push_back(cell);
+	}
+
+	while (std::getline(in, line))
+	{
+		std::map<std::string, std::string> row;
+		std::stringstream row_stream(line);
+		for (size_t c = 0; c < header.size() && std::getline(row_stream, cell, ','); ++c)
+		{
+			row[header[c]] = cell;
+		}
+		if (row.count("spheres") && row.count("width") && row.count("height") && row.count("threads") && row.count("rays_per_sec"))
+		{
+			std::string key = result_key(atoi(row["spheres"].c_str()), atoi(row["width"].c_str()), atoi(row["height"].c_str()), atoi(row["threads"].c_str()));
+			rays_per_sec[key] = atof(row["rays_per_sec"].c_str());
+		}
+	}
+	return true;
+}
+
+// Checks whether a golden image has been stored yet
+bool golden_exists(const std::string& path)
+{
+	std::ifstream in(path);
+	return bool(in);
+}
+
+// The golden folder next to this source file, so the stored images are found from any working directory
+std::string default_golden_dir()
+{
+	const std::string source = __FILE__;
+	const size_t slash = source.find_last_of("/\\");
+	return slash == std::string::npos ? std::string("golden") : source.substr(0, slash + 1) + "golden";
+}
+
+// Loads the golden image for this scene. A missing one is an error, unless update is set: then it is rendered with
+// render_reference (never the code being checked) and stored. golden must already have the size of the image it will be compared against
+bool load_or_make_golden(const std::string& path, const Hittable& world, const Camera& cam, Image& golden, bool update)
+{
+	const int width = golden.width, height = golden.height;
+	std::ifstream in(path);
+	if (in)
+	{
+		if (read_ppm(in, golden) && golden.width == width && golden.height == height)
+		{
+			return true;
+		}
+		std::cerr << "Golden image " << path << " is not a " << width << 'x' << height << " PPM\n";
+		return false;
+	}
+	if (!update)
+	{
+		std::cerr << "Golden image " << path << " is missing (run with --update-golden to make it)\n";
+		return false;
+	}
+
+	golden = Image(width, height);
+	render_reference(world, cam, golden);
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cerr << "Could not store golden image " << path << '\n';
+		return false;
+	}
+	write_ppm(out, golden);
+	std::cerr << "Stored new golden image " << path << '\n';
+	return true;
+}
+
+int main(int const argc, char const* const argv[])
+{
+	std::vector<int> sphere_counts = { 2, 1000, 100000, 1000000 };
+	std::vector<int> widths = { 100, 400 };
+	std::vector<int> thread_counts = { 1, 0 };
+	int repeat = 1;
+	double max_work = 1e10;
+	uint32_t seed = 1u;
+	std::string golden_dir = default_golden_dir();
+	bool update_golden = false;
+	const char* csv_path = nullptr;
+	const char* json_path = nullptr;
+	const char* compare_path = nullptr;
+	double threshold = 0.10;
+	std::vector<int> budgets;
+	const char* progressive_csv_path = nullptr;
+	int denoise_spp = 0;
+	int reference_spp = 64;
+	const char* denoise_csv_path = nullptr;
+	bool cull = true;
+	int job_count = 0;
+
+	// Read the options
+	for (int a = 1; a < argc; ++a)
+	{
+		const bool has_value = a + 1 < argc;
+		if (!strcmp(argv[a], "--spheres") && has_value) sphere_counts = parse_int_list(argv[++a]);
+		else if (!strcmp(argv[a], "--widths") && has_value) widths = parse_int_list(argv[++a]);
+		else if (!strcmp(argv[a], "--threads") && has_value) thread_counts = parse_int_list(argv[++a]);
+		else if (!strcmp(argv[a], "--repeat") && has_value) repeat = atoi(argv[++a]);
+		else if (!strcmp(argv[a], "--max-work") && has_value) max_work = atof(argv[++a]);
+		else if (!strcmp(argv[a], "--seed") && has_value) seed = uint32_t(strtoul(argv[++a], nullptr, 10));
+		else if (!strcmp(argv[a], "--golden-dir") && has_value) golden_dir = argv[++a];
+		else if (!strcmp(argv[a], "--update-golden")) update_golden = true;
+		else if (!strcmp(argv[a], "--csv") && has_value) csv_path = argv[++a];
+		else if (!strcmp(argv[a], "--json") && has_value) json_path = argv[++a];
+		else if (!strcmp(argv[a], "--compare") && has_value) compare_path = argv[++a];
+		else if (!strcmp(argv[a], "--threshold") && has_value) threshold = atof(argv[++a]);
+		else if (!strcmp(argv[a], "--budgets") && has_value) budgets = parse_int_list(argv[++a]);
+		else if (!strcmp(argv[a], "--progressive-csv") && has_value) progressive_csv_path = argv[++a];
+		else if (!strcmp(argv[a], "--denoise-spp") && has_value) denoise_spp = atoi(argv[++a]);
+		else if (!strcmp(argv[a], "--reference-spp") && has_value) reference_spp = atoi(argv[++a]);
+		else if (!strcmp(argv[a], "--denoise-csv") && has_value) denoise_csv_path = argv[++a];
+		else if (!strcmp(argv[a], "--cull") && has_value) cull = atoi(argv[++a]) != 0;
+		else if (!strcmp(argv[a], "--jobs") && has_value) job_count = atoi(argv[++a]);
+		else
+		{
+			std::cerr << "Unknown option " << argv[a] << " (see the top of GPRO-Graphics1-Benchmark-main.cpp)\n";
+			return 2;
+		}
+	}
+
+	const float aspect_ratio = 16.0f / 9.0f;
+	const Camera cam(aspect_ratio, 2.0f, 1.0f);
+	std::vector<Bench_result> results;
+	std::vector<Progressive_row> progressive_rows;
+	std::vector<Denoise_row> denoise_rows;
+	bool failed = false;
+
+	// The baked BVH has to hit the same spheres as testing every one of them
+	Hittable_list row_world;
+	build_row_scene(row_world);
+	for (size_t w = 0; w < widths.size(); ++w)
+	{
+		const int image_width = widths[w];
+		const int image_height = static_cast<int>(image_width / aspect_ratio);
+		std::ostringstream golden_path;
+		golden_path << golden_dir << "/golden_baked_row_w" << image_width << ".ppm";
+		Image golden(image_width, image_height), baked(image_width, image_height);
+		if (!load_or_make_golden(golden_path.str(), row_world, cam, golden, update_golden))
+		{
+			failed = true;
+			continue;
+		}
+		render(baked_row_scene, cam, baked);
+		if (image_checksum(baked) != image_checksum(golden))
+		{
+			std::cerr << "baked_row_scene/" << image_width << 'x' << image_height << ": BAKED SCENE CHANGED PIXELS (PSNR " << image_psnr(baked, golden) << " dB)\n";
+			failed = true;
+		}
+	}
+
+	for (size_t s = 0; s < sphere_counts.size(); ++s)
+	{
+		Hittable_list world;
+		build_scene(world, sphere_counts[s], seed, cam);
+
+		for (size_t w = 0; w < widths.size(); ++w)
+		{
+			const int image_width = widths[w];
+			const int image_height = static_cast<int>(image_width / aspect_ratio);
+			std::ostringstream golden_path;
+			golden_path << golden_dir << "/golden_s" << sphere_counts[s] << "_w" << image_width << "_seed" << seed << ".ppm";
+
+			// Only renders without culling cost every sphere for every pixel, with culling and a stored golden image any size can run
+			const double reference_work = double(world.objects.size()) * double(image_width) * double(image_height);
+			const bool over_max_work = reference_work / double(resolve_thread_count(0)) > max_work;
+			if ((!golden_exists(golden_path.str()) && reference_work > max_work) || (over_max_work && !cull))
+			{
+				std::cerr << "Skipping " << sphere_counts[s] << " spheres at " << image_width << 'x' << image_height
+					<< (cull ? " (no golden image, making one is over --max-work)\n" : " (over --max-work without --cull)\n");
+				continue;
+			}
+			Image golden(image_width, image_height);
+			if (!load_or_make_golden(golden_path.str(), world, cam, golden, update_golden))
+			{
+				failed = true;
+				continue;
+			}
+			const uint64_t golden_checksum = image_checksum(golden);
+
+			// How many spheres the tile bins leave each primary ray, render bins them again on every call
+			double binning_ms = 0.0;
+			double tests_per_ray = double(world.objects.size());
+			if (cull)
+			{
+				Tile_bins bins;
+				auto binning_start = std::chrono::steady_clock::now();
+				bins.build(world, cam, image_width, image_height, Render_settings().tile_size);
+				binning_ms = elapsed_ms(binning_start);
+				tests_per_ray = bins.average_candidates();
+			}
+
+			// Culling has to give the same pixels for a camera that is moved away from the origin and tilted, not only the default one
+			if (cull && over_max_work)
+			{
+				std::cerr << "Skipping the moved camera check for " << sphere_counts[s] << " spheres at " << image_width << 'x' << image_height << " (over --max-work)\n";
+			}
+			else if (cull)
+			{
+				const Camera moved_cam(point3(0.7f, 0.4f, 0.3f), point3(-0.2f, -0.1f, -2.0f), vec3(0.2f, 1.0f, 0.0f), aspect_ratio, 2.0f, 1.0f);
+				Image culled(image_width, image_height), unculled(image_width, image_height);
+				Render_settings check_settings;
+				render(world, moved_cam, culled, check_settings);
+				check_settings.cull_tiles = false;
+				render(world, moved_cam, unculled, check_settings);
+				if (image_checksum(culled) != image_checksum(unculled))
+				{
+					std::cerr << sphere_counts[s] << '/' << image_width << 'x' << image_height << ": CULLING CHANGED PIXELS for a moved camera (PSNR "
+						<< image_psnr(culled, unculled) << " dB)\n";
+					failed = true;
+				}
+			}
+
+			std::vector<int> threads_done;
+			for (size_t t = 0; t < thread_counts.size(); ++t)
+			{
+				Render_settings settings;
+				settings.thread_count = std::min(resolve_thread_count(thread_counts[t]), Render_pool::shared().worker_count() + 1);
+				settings.cull_tiles = cull;
+				if (settings.thread_count < thread_counts[t] && s == 0 && w == 0)
+				{
+					std::cerr << "Running " << thread_counts[t] << " threads as " << settings.thread_count << ", the pool has "
+						<< Render_pool::shared().worker_count() << " workers\n";
+				}
+
+				// 0 and the hardware thread count are the same run, and so are counts above what the pool can run
+				if (std::find(threads_done.begin(), threads_done.end(), settings.thread_count) != threads_done.end())
+				{
+					continue;
+				}
+				threads_done.push_back(settings.thread_count);
+
+				// Keep the fastest of the repeats. The memory peak starts over here, so earlier (bigger) scenes do not show up in it
+				const bool measuring_rss = reset_peak_rss();
+				Image image(image_width, image_height);
+				double best_seconds = 0.0;
+				for (int r = 0; r < repeat || r == 0; ++r)
+				{
+					auto start = std::chrono::steady_clock::now();
+					render(world, cam, image, settings);
+					double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+					if (r == 0 || seconds < best_seconds)
+					{
+						best_seconds = seconds;
+					}
+				}
+
+				Bench_result result;
+				result.spheres = sphere_counts[s];
+				result.width = image_width;
+				result.height = image_height;
+				result.threads = settings.thread_count;
+				result.seconds = best_seconds;
+				result.rays_per_sec = best_seconds > 0.0 ? double(image_width) * double(image_height) / best_seconds : 0.0;
+				result.peak_rss_bytes = measuring_rss ? peak_rss_bytes() : 0;
+				result.binning_ms = binning_ms;
+				result.tests_per_ray = tests_per_ray;
+				result.checksum = image_checksum(image);
+				result.golden_checksum = golden_checksum;
+				result.pixels_match = result.checksum == golden_checksum;
+				result.psnr_db = image_psnr(image, golden);
+				results.push_back(result);
+
+				std::cerr << result_key(result.spheres, result.width, result.height, result.threads) << ": "
+					<< result.seconds << " s, " << result.rays_per_sec << " rays/s, " << result.tests_per_ray << " tests/ray"
+					<< (result.pixels_match ? "" : ", PIXELS CHANGED") << '\n';
+				if (!result.pixels_match)
+				{
+					failed = true;
+				}
+
+				// Quality reached by the progressive renderer in each time budget
+				for (size_t b = 0; b < budgets.size(); ++b)
+				{
+					Progressive_settings progressive_settings;
+					progressive_settings.time_budget_ms = double(budgets[b]);
+					progressive_settings.thread_count = settings.thread_count;
+					Progressive_result progressive = render_progressive(world, cam, image, progressive_settings);
+
+					Progressive_row row;
+					row.spheres = sphere_counts[s];
+					row.width = image_width;
+					row.height = image_height;
+					row.threads = settings.thread_count;
+					row.budget_ms = progressive_settings.time_budget_ms;
+					row.elapsed_ms = progressive.elapsed_ms;
+					row.finest_block = progressive.finest_block;
+					row.traced_fraction = double(progressive.traced_pixels) / (double(image_width) * double(image_height));
+					row.pixels_match = image_checksum(image) == golden_checksum;
+					row.psnr_db = image_psnr(image, golden);
+					progressive_rows.push_back(row);
+
+					// A finished progressive render has to give the golden pixels too
+					if (progressive.complete() && !row.pixels_match)
+					{
+						std::cerr << result_key(row.spheres, row.width, row.height, row.threads) << ": PROGRESSIVE PIXELS CHANGED\n";
+						failed = true;
+					}
+				}
+
+				// Few samples plus the denoiser against many samples
+				if (denoise_spp > 0)
+				{
+					Denoise_row row;
+					row.spheres = sphere_counts[s];
+					row.width = image_width;
+					row.height = image_height;
+					row.threads = settings.thread_count;
+					row.low_spp = denoise_spp;
+					row.reference_spp = reference_spp;
+
+					Image reference(image_width, image_height);
+					Render_settings reference_settings = settings;
+					reference_settings.samples_per_pixel = reference_spp;
+					auto start = std::chrono::steady_clock::now();
+					render(world, cam, reference, reference_settings);
+					row.reference_ms = elapsed_ms(start);
+
+					Feature_buffers features;
+					Render_settings low_settings = settings;
+					low_settings.samples_per_pixel = denoise_spp;
+					low_settings.features = &features;
+					start = std::chrono::steady_clock::now();
+					render(world, cam, image, low_settings);
+					row.low_ms = elapsed_ms(start);
+
+					Image denoised;
+					Denoise_settings denoise_settings;
+					denoise_settings.thread_count = settings.thread_count;
+					start = std::chrono::steady_clock::now();
+					if (!denoise(image, features, denoised, denoise_settings))
+					{
+						std::cerr << result_key(row.spheres, row.width, row.height, row.threads) << ": FEATURES DO NOT MATCH THE IMAGE\n";
+						failed = true;
+						continue;
+					}
+					row.denoise_ms = elapsed_ms(start);
+					row.denoise_ms_per_mpixel = row.denoise_ms / (double(image_width) * double(image_height) * 1e-6);
+
+					row.low_psnr_db = image_psnr(image, reference);
+					row.denoised_psnr_db = image_psnr(denoised, reference);
+					denoise_rows.push_back(row);
+
+					// One sample per pixel has no variance, so the denoiser leaves it alone. With more it has to get closer to the reference
+					if (denoise_spp > 1 && !(row.denoised_psnr_db > row.low_psnr_db))
+					{
+						std::cerr << result_key(row.spheres, row.width, row.height, row.threads) << ": DENOISING DID NOT HELP ("
+							<< row.low_psnr_db << " -> " << row.denoised_psnr_db << " dB)\n";
+						failed = true;
+					}
+				}
+			}
+
+			// Concurrent jobs share the pool's workers, together they should run about as fast as one render on every thread
+			if (job_count > 0)
+			{
+				Render_job_settings job_settings;
+				job_settings.width = image_width;
+				job_settings.height = image_height;
+				job_settings.cull_tiles = cull;
+
+				auto start = std::chrono::steady_clock::now();
+				std::vector<Render_job> jobs;
+				for (int k = 0; k < job_count; ++k)
+				{
+					jobs.push_back(render(world, cam, job_settings));
+				}
+				bool jobs_match = true;
+				for (size_t k = 0; k < jobs.size(); ++k)
+				{
+					jobs_match = jobs_match && image_checksum(jobs[k].image()) == golden_checksum;
+				}
+				const double seconds = elapsed_ms(start) * 1e-3;
+
+				std::cerr << sphere_counts[s] << '/' << image_width << 'x' << image_height << '/' << Render_pool::shared().worker_count()
+					<< " workers, " << job_count << " jobs: " << seconds << " s, "
+					<< double(job_count) * double(image_width) * double(image_height) / seconds << " rays/s"
+					<< (jobs_match ? "" : ", JOB PIXELS CHANGED") << '\n';
+				if (!jobs_match)
+				{
+					failed = true;
+				}
+			}
+		}
+	}
+
+	// Write the results
+	if (csv_path)
+	{
+		std::ofstream out(csv_path);
+		write_csv(out, results);
+	}
+	if (json_path)
+	{
+		std::ofstream out(json_path);
+		write_json(out, results);
+	}
+	if (!csv_path && !json_path)
+	{
+		write_csv(std::cout, results);
+	}
+	if (progressive_csv_path)
+	{
+		std::ofstream out(progressive_csv_path);
+		write_progressive_csv(out, progressive_rows);
+	}
+	else if (!progressive_rows.empty())
+	{
+		write_progressive_csv(std::cerr, progressive_rows);
+	}
+	if (denoise_csv_path)
+	{
+		std::ofstream out(denoise_csv_path);
+		write_denoise_csv(out, denoise_rows);
+	}
+	else if (!denoise_rows.empty())
+	{
+		write_denoise_csv(std::cerr, denoise_rows);
+	}
+
+	// Compare against an older run
+	if (compare_path)
+	{
+		std::map<std::string, double> baseline;
+		if (!read_baseline(compare_path, baseline))
+		{
+			std::cerr << "Could not read " << compare_path << '\n';
+			return 2;
+		}
+		for (size_t k = 0; k < results.size(); ++k)
+		{
+			const Bench_result& r = results[k];
+			std::string key = result_key(r.spheres, r.width, r.height, r.threads);
+			std::map<std::string, double>::const_iterator old = baseline.find(key);
+			if (old == baseline.end() || old->second <= 0.0)
+			{
+				continue;
+			}
+			double change = r.rays_per_sec / old->second - 1.0;
+			if (change < -threshold)
+			{
+				std::cerr << "REGRESSION " << key << ": " << old->second << " -> " << r.rays_per_sec << " rays/s (" << change * 100.0 << "%)\n";
+				failed = true;
+			}
+		}
+	}
+
+	return failed ? 1 : 0;
+}
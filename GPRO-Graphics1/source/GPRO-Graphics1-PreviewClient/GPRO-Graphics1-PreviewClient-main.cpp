@@ -0,0 +1,177 @@
+/*
+   Copyright 2020 Colin Deane
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+	GPRO-Graphics1-PreviewClient-main.cpp
+	Main entry point for the reference preview client.
+
+	Connects to the preview server of a running render (GPRO-Graphics1-TestConsole --preview-port N), puts the tiles together
+	into an image and writes it as a PPM when the frame is done. Reports how long the first tile and the whole frame took to arrive.
+
+	Usage: GPRO-Graphics1-PreviewClient [--port 5200] [--out preview.ppm] [--frames 1]
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gpro/image.h"
+#include "gpro/preview.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string.h>
+#include <vector>
+
+
+// Connect to the preview server on 127.0.0.1:port, keeps trying for up to timeout_ms so the client can be started first
+preview_socket connect_to_server(unsigned short port, int timeout_ms)
+{
+	const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	for (;;)
+	{
+		preview_socket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (s == preview_invalid_socket)
+		{
+			return s;
+		}
+
+		sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (connect(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+		{
+			return s;
+		}
+		preview_close_socket(s);
+
+		if (std::chrono::steady_clock::now() >= deadline)
+		{
+			return preview_invalid_socket;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+}
+
+int main(int const argc, char const* const argv[])
+{
+	int port = 5200;
+	std::string out_path = "preview.ppm";
+	int frames = 1;
+	for (int a = 1; a + 1 < argc; ++a)
+	{
+		if (strcmp(argv[a], "--port") == 0) port = atoi(argv[++a]);
+		else if (strcmp(argv[a], "--out") == 0) out_path = argv[++a];
+		else if (strcmp(argv[a], "--frames") == 0) frames = atoi(argv[++a]);
+	}
+
+	if (!preview_socket_startup())
+	{
+		return 1;
+	}
+	preview_socket s = connect_to_server(static_cast<unsigned short>(port), 10000);
+	if (s == preview_invalid_socket)
+	{
+		std::cerr << "Could not connect to 127.0.0.1:" << port << '\n';
+		preview_socket_cleanup();
+		return 1;
+	}
+
+	Image image;
+	std::vector<unsigned char> data;
+	std::chrono::steady_clock::time_point frame_start;
+	bool first_tile = false;
+	int frames_done = 0;
+	unsigned char header[32];
+
+	while (frames_done < frames)
+	{
+		// Every message starts with its type and frame id
+		if (!preview_recv_all(s, header, 5))
+		{
+			break;
+		}
+
+		if (header[0] == 'F')
+		{
+			if (!preview_recv_all(s, header + 5, 8))
+			{
+				break;
+			}
+			image = Image(int(preview_get_u32(header + 5)), int(preview_get_u32(header + 9)));
+			frame_start = std::chrono::steady_clock::now();
+			first_tile = true;
+		}
+		else if (header[0] == 'T')
+		{
+			if (!preview_recv_all(s, header + 5, 20))
+			{
+				break;
+			}
+			data.resize(preview_get_u32(header + 21));
+			if (!preview_recv_all(s, data.data(), data.size()))
+			{
+				break;
+			}
+			if (!preview_decode_tile(data.data(), data.size(), int(preview_get_u32(header + 5)), int(preview_get_u32(header + 9)),
+				int(preview_get_u32(header + 13)), int(preview_get_u32(header + 17)), image))
+			{
+				std::cerr << "Bad tile\n";
+				break;
+			}
+			if (first_tile)
+			{
+				first_tile = false;
+				std::cerr << "First tile after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count() << " ms\n";
+			}
+		}
+		else if (header[0] == 'E')
+		{
+			if (!preview_recv_all(s, header + 5, 4))
+			{
+				break;
+			}
+			const uint32_t dropped = preview_get_u32(header + 5);
+			std::cerr << "Frame " << preview_get_u32(header + 1) << " after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count()
+				<< " ms, " << dropped << " tiles dropped\n";
+
+			// Name every frame after the first one so they do not overwrite each other
+			std::ostringstream path;
+			path << out_path;
+			if (frames_done > 0)
+			{
+				path << '.' << frames_done;
+			}
+			std::ofstream out(path.str().c_str());
+			write_ppm(out, image);
+			++frames_done;
+		}
+		else
+		{
+			std::cerr << "Unknown message\n";
+			break;
+		}
+	}
+
+	preview_close_socket(s);
+	preview_socket_cleanup();
+	return frames_done == frames ? 0 : 1;
+}
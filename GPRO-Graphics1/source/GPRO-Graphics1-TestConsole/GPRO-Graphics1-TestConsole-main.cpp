@@ -34,6 +34,12 @@
 #include "gpro/hittable_list.h"
 #include "gpro/color.h"
 #include "gpro/sphere.h"
+#include "gpro/render.h" // ray_color is shared with the benchmark
+#include "gpro/render_job.h"
+#include "gpro/progressive.h"
+#include "gpro/preview.h"
+#include "gpro/scene.h"
+#include "gpro/tile_bins.h"
 
 
 void testVector()
@@ -59,28 +65,46 @@ void testVector()
 }
 
 #include <iostream>
+#include <string.h>
 
 
-// Gets the color of the ray based on any collisions
-color ray_color(const ray& r, const Hittable& world)
+int main(int const argc, char const* const argv[])
 {
-	//Creates a hit_record to store the hit
-	hit_record rec;
-	if (world.hit(r, 0, infinity, rec)) // If there is a collision
+	// Options
+
+	double time_budget_ms = 0.0; // "--budget-ms N" renders coarse-to-fine and stops refining after N milliseconds
+	int preview_port = 0;		// "--preview-port N" streams finished tiles to preview clients on 127.0.0.1:N
+	int preview_wait_ms = 0;	// "--preview-wait-ms N" waits up to N milliseconds for a preview client before rendering
+	bool baked = false;			// "--baked" renders the compile-time copy of the scene instead of building it at startup
+	bool async = false;			// "--async" renders through the job API on the shared worker pool
+	for (int a = 1; a < argc; ++a)
 	{
-		// Get the normal and white to it then multiply by half
-		return (rec.normal + color(1, 1, 1)) * 0.5f;
+		if (strcmp(argv[a], "--baked") == 0)
+		{
+			baked = true;
+		}
+		else if (strcmp(argv[a], "--async") == 0)
+		{
+			async = true;
+		}
+		else if (a + 1 >= argc)
+		{
+			break;
+		}
+		else if (strcmp(argv[a], "--budget-ms") == 0)
+		{
+			time_budget_ms = atof(argv[++a]);
+		}
+		else if (strcmp(argv[a], "--preview-port") == 0)
+		{
+			preview_port = atoi(argv[++a]);
+		}
+		else if (strcmp(argv[a], "--preview-wait-ms") == 0)
+		{
+			preview_wait_ms = atoi(argv[++a]);
+		}
 	}
-	//Create the gradient in the background
-	vec3 unit_direction = unit_vector(r.direction());
-	float t = (unit_direction.y + 1.0f) * 0.5f;
-	return (color(1.0f, 1.0f, 1.0f) * (1.0f - t) + (color(0.5f, 0.7f, 1.0f) * t));
-	
-	
-}
 
-int main(int const argc, char const* const argv[])
-{
 	// Image 
 
 	const float aspect_ratio = 16.0f / 9.0f; // 16:9 aspect ratio
@@ -91,6 +115,7 @@ int main(int const argc, char const* const argv[])
 	Hittable_list world;
 	world.add(make_shared<Sphere>(point3(0, 0, -1), 0.5f));			// Create a small sphere at the center of the viewport with a radius of .5
 	world.add(make_shared<Sphere>(point3(0, -100.5, -1), 100.0f));	// Create a large sphere super far outside the viewport (-100 y) with a radius of 100
+	const Hittable& scene = baked ? static_cast<const Hittable&>(baked_default_scene) : world;	// The same spheres, baked at compile time
 
 	// Camera
 	float viewport_height = 2.0;
@@ -102,8 +127,77 @@ int main(int const argc, char const* const argv[])
 	vec3 vertical = vec3(0, viewport_height, 0);		// Vector for tracking vertical movement
 	point3 lower_left_corner = origin - (horizontal / 2) - (vertical / 2) - vec3(0, 0, focal_length); // Calculate the lower left corner of the image
 
+	// Culling
+
+	// Project every sphere through the camera and bin it into 16x16 pixel tiles, so each ray only tests the spheres that can show up in its tile
+	Camera view;
+	view.origin = origin;
+	view.lower_left_corner = lower_left_corner;
+	view.horizontal = horizontal;
+	view.vertical = vertical;
+	Tile_bins bins;
+	bins.build(world, view, image_width, image_height, 16);
+
 	// Render
 
+	if (time_budget_ms > 0.0)
+	{
+		// Render into an image first so the best image so far can be written when the budget runs out
+		Image image(image_width, image_height);
+		Progressive_settings settings;
+		settings.time_budget_ms = time_budget_ms;
+		Progressive_result result = render_progressive(scene, Camera(aspect_ratio, viewport_height, focal_length), image, settings);
+		write_ppm(std::cout, image);
+
+		std::cerr << "Finest block: " << result.finest_block << "x" << result.finest_block << " after " << result.elapsed_ms << " ms\n";
+		std::cerr << "\nDone.\n";
+		system("pause");
+		return 0;
+	}
+
+	if (async)
+	{
+		// Queue the render and report its progress from the workers, at most ten times a second
+		Render_job_settings settings;
+		settings.width = image_width;
+		settings.height = image_height;
+		settings.progress = [](const Render_progress& progress)
+		{
+			std::cerr << "\rTiles done: " << progress.tiles_done << '/' << progress.tile_count << ' ' << std::flush;
+		};
+		Render_job job = render(scene, Camera(aspect_ratio, viewport_height, focal_length), settings);
+		write_ppm(std::cout, job.image());	// image() waits for the job
+
+		std::cerr << "\nDone.\n";
+		system("pause");
+		return 0;
+	}
+
+	if (preview_port > 0)
+	{
+		Preview_server preview;
+		if (!preview.start(static_cast<unsigned short>(preview_port)))
+		{
+			std::cerr << "Could not start the preview server on port " << preview_port << '\n';
+			return 1;
+		}
+		preview.wait_for_client(preview_wait_ms);
+
+		// Render in tiles and hand each one to the preview server as soon as it is done
+		Image image(image_width, image_height);
+		Render_settings settings;
+		settings.tile_done = [&](int x0, int y0, int x1, int y1) { preview.push_tile(image, x0, y0, x1, y1); };
+		preview.begin_frame(image_width, image_height);
+		render(scene, Camera(aspect_ratio, viewport_height, focal_length), image, settings);
+		preview.end_frame(image);
+		write_ppm(std::cout, image);
+		preview.stop();
+
+		std::cerr << "\nDone.\n";
+		system("pause");
+		return 0;
+	}
+
 	std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
 
 	// Use this loop to create RGB values for individual pixels going from left-to-right and top-to-bottom
@@ -117,8 +211,9 @@ int main(int const argc, char const* const argv[])
 		{
 			float u = float(i) / (image_width - 1);									// 'u' will vary from 0 to 1
 			float v = float(j) / (image_height - 1);								// 'v' will vary from 0 to 1
-			ray r(origin, lower_left_corner + (horizontal * u) + (vertical * v));	// Create a ray that has its origin at the camera origin and it's direction based from the lower left corner
-			color pixel_color = ray_color(r, world);								// Color the pixel based on the calculated ray color
+			ray r(origin, lower_left_corner + (horizontal * u) + (vertical * v) - origin);	// Create a ray that has its origin at the camera origin and it's direction based from the lower left corner
+			const Hittable& candidates = baked ? scene : static_cast<const Hittable&>(bins.tile_at(i, j));	// The spheres of this pixel's tile
+			color pixel_color = ray_color(r, candidates);							// Color the pixel based on the calculated ray color
 			write_color(std::cout, pixel_color);									// Write the color to the screen
 
 			/*OLDER ITERATIONS